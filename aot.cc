@@ -0,0 +1,488 @@
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+#include <utility>
+
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+
+#include "aot.hh"
+#include "regionProfile.hh"
+#include "regionCFG.hh"
+#include "riscvInstruction.hh"
+#include "basicBlock.hh"
+#include "state.hh"
+#include "helper.hh"
+#include "hle.hh"
+#include "globals.hh"
+
+#ifdef __APPLE__
+#include <TargetConditionals.h>
+#if TARGET_OS_MAC
+#include <libelf/gelf.h>
+#endif /* TARGET_OS_MAC */
+#else
+#include <elf.h>
+#endif
+
+uint64_t aot::functions = 0;
+uint64_t aot::blocks = 0;
+uint64_t aot::regionsCompiled = 0;
+uint64_t aot::regionsRejected = 0;
+uint64_t aot::regionsLoaded = 0;
+uint64_t aot::regionsNotLoaded = 0;
+
+/* what the object exports besides the region entry points
+ * (cfg_<head>, cfg_<head>_body with chained regions) and
+ * regionCFG::relocTable */
+static const char *keySym = "rv32_aot_key";
+static const char *regionsSym = "rv32_aot_regions";
+static const char *osrSym = "rv32_aot_osr";
+static const char *relocIdsSym = "rv32_aot_reloc_ids";
+static const char *numRelocsSym = "rv32_aot_nrelocs";
+
+typedef std::vector<std::pair<uint32_t, uint32_t>> textRanges;
+
+/* executable sections, the entry point and the function symbols
+ * in them, load_elf only keeps symbol names and values around and
+ * starts the pc in its boot stub */
+static bool readElf(const std::string &elfName, textRanges &text,
+		    std::set<uint32_t> &funcs) {
+  struct stat st;
+  int fd = open(elfName.c_str(), O_RDONLY);
+  if(fd < 0) {
+    return false;
+  }
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  char *buf = reinterpret_cast<char*>(mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+  close(fd);
+  if(buf == reinterpret_cast<char*>(MAP_FAILED)) {
+    return false;
+  }
+  Elf32_Ehdr *eh32 = reinterpret_cast<Elf32_Ehdr*>(buf);
+  Elf32_Shdr *sh32 = reinterpret_cast<Elf32_Shdr*>(buf + eh32->e_shoff);
+  std::set<uint32_t> execSections;
+  int32_t symtabidx = -1;
+  for(int32_t i = 0; i < eh32->e_shnum; i++) {
+    if((sh32[i].sh_flags & SHF_EXECINSTR) and sh32[i].sh_type == SHT_PROGBITS) {
+      text.emplace_back(sh32[i].sh_addr, sh32[i].sh_addr + sh32[i].sh_size);
+      execSections.insert(i);
+    }
+    if(sh32[i].sh_type == SHT_SYMTAB) {
+      symtabidx = i;
+    }
+  }
+  funcs.insert(eh32->e_entry);
+  if(symtabidx >= 0) {
+    Elf32_Sym *sym = reinterpret_cast<Elf32_Sym*>(buf + sh32[symtabidx].sh_offset);
+    for(uint32_t i = 0; i < (sh32[symtabidx].sh_size / sizeof(Elf32_Sym)); i++) {
+      if(ELF32_ST_TYPE(sym[i].st_info) == STT_FUNC and
+	 execSections.count(sym[i].st_shndx)) {
+	funcs.insert(sym[i].st_value);
+      }
+    }
+  }
+  munmap(buf, st.st_size);
+  return true;
+}
+
+/* code in an object is only good for the host target, the flags
+ * that change what is generated and the text it came from */
+static std::string objectKey(const textRanges &text, state_t *s) {
+  uint32_t crc = ~0U;
+  for(const auto &r : text) {
+    crc = update_crc(crc, s->mem + r.first, r.second - r.first);
+  }
+  std::stringstream ss;
+  ss << regionCFG::hostTargetKey()
+     << ";chainRegions=" << globals::chainRegions
+     << ",memGuard=" << globals::memGuard
+     << ",countInsns=" << globals::countInsns
+     << ",deferIcnt=" << globals::deferIcnt
+     << ",hle=" << globals::hle
+     << ";text=" << std::hex << (crc ^ ~0U);
+  return ss.str();
+}
+
+static void defineString(llvm::Module *m, const char *name, const std::string &str) {
+  llvm::Constant *c = llvm::ConstantDataArray::getString(m->getContext(), str);
+  new llvm::GlobalVariable(*m, c->getType(), true, llvm::GlobalValue::ExternalLinkage,
+			   c, name);
+}
+
+/* the relocation table sized to what the regions asked for, its
+ * kinds and keys, and the blocks and side entries load rebuilds */
+static void defineTables(llvm::Module *m, const std::string &key) {
+  llvm::LLVMContext &C = m->getContext();
+  const auto &relocs = regionCFG::sharedRelocs;
+  llvm::ArrayType *tblTy = llvm::ArrayType::get(llvm::Type::getInt64Ty(C), relocs.size());
+  llvm::GlobalVariable *tbl =
+    new llvm::GlobalVariable(*m, tblTy, false, llvm::GlobalValue::ExternalLinkage,
+			     llvm::ConstantAggregateZero::get(tblTy));
+  /* exported for load, the code reaches it pc relative */
+  tbl->setVisibility(llvm::GlobalValue::ProtectedVisibility);
+  if(llvm::GlobalVariable *decl = m->getGlobalVariable(regionCFG::relocTable)) {
+    decl->replaceAllUsesWith(llvm::ConstantExpr::getBitCast(tbl, decl->getType()));
+    decl->eraseFromParent();
+  }
+  tbl->setName(regionCFG::relocTable);
+
+  std::vector<uint32_t> ids;
+  for(const auto &r : relocs) {
+    ids.push_back(static_cast<uint32_t>(r.first));
+    ids.push_back(r.second);
+  }
+  llvm::Constant *cIds = llvm::ConstantDataArray::get(C, ids);
+  new llvm::GlobalVariable(*m, cIds->getType(), true, llvm::GlobalValue::ExternalLinkage,
+			   cIds, relocIdsSym);
+  llvm::Constant *cN = llvm::ConstantInt::get(llvm::Type::getInt64Ty(C), relocs.size());
+  new llvm::GlobalVariable(*m, cN->getType(), true, llvm::GlobalValue::ExternalLinkage,
+			   cN, numRelocsSym);
+
+  std::stringstream prof, osr;
+  regionProfile::save(prof);
+  /* head n {pc}* */
+  osr << std::hex;
+  for(const regionCFG *r : regionCFG::regionCFGs) {
+    osr << r->getEntryAddr() << " " << r->osrBlocks.size();
+    for(const basicBlock *bb : r->osrBlocks) {
+      osr << " " << bb->getEntryAddr();
+    }
+    osr << "\n";
+  }
+  defineString(m, keySym, key);
+  defineString(m, regionsSym, prof.str());
+  defineString(m, osrSym, osr.str());
+}
+
+static bool inText(const textRanges &text, uint32_t pc) {
+  for(const auto &r : text) {
+    if(pc >= r.first and (pc + 4) <= r.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* descent runs into data now and then, regions only take
+ * blocks the code generator has an insn for everywhere */
+template <typename F>
+static bool decodes(const F &insnAt, uint32_t entry, uint32_t term) {
+  for(uint32_t pc = entry; pc <= term; pc += 4) {
+    Insn *ins = getInsn(insnAt(pc), pc);
+    if(ins == nullptr) {
+      return false;
+    }
+    delete ins;
+  }
+  return true;
+}
+
+void aot::translate(const std::string &elfName, state_t *s,
+		    const std::string &soName) {
+  textRanges text;
+  std::set<uint32_t> funcs;
+  if(not(readElf(elfName, text, funcs))) {
+    std::cerr << "can't read " << elfName << " for translation\n";
+    return;
+  }
+  auto insnAt = [s](uint32_t pc) {
+    return *reinterpret_cast<uint32_t*>(s->mem + pc);
+  };
+
+  /* recursive descent from every function symbol. a walk runs to
+   * the first branch or jump, or stops at code an earlier walk
+   * decoded (always at that walk's leader). return points of
+   * calls head their own regions as a callee returns to them
+   * through a jalr */
+  std::set<uint32_t> leaders, heads(funcs), decoded;
+  std::vector<uint32_t> work(funcs.begin(), funcs.end());
+  while(not(work.empty())) {
+    uint32_t pc = work.back();
+    work.pop_back();
+    if((pc & 3) or not(inText(text, pc))) {
+      continue;
+    }
+    leaders.insert(pc);
+    for(; inText(text, pc) and decoded.insert(pc).second; pc += 4) {
+      uint32_t insn = insnAt(pc), target = 0;
+      if(not(isBranchOrJump(insn))) {
+	continue;
+      }
+      if(not(isDirectBranchOrJump(insn, pc, target))) {
+	if(is_jalr(insn) and heads.insert(pc + 4).second) {
+	  work.push_back(pc + 4);
+	}
+      }
+      else if(is_jal(insn)) {
+	/* hle calls continue at ra in place of the callee */
+	if(hleLookup(target) < 0) {
+	  if(heads.insert(target).second) {
+	    work.push_back(target);
+	  }
+	  heads.insert(pc + 4);
+	}
+	work.push_back(pc + 4);
+      }
+      else {
+	work.push_back(target);
+	if(is_branch(insn)) {
+	  work.push_back(pc + 4);
+	}
+      }
+      break;
+    }
+  }
+
+  /* blocks end like the interpreter ends them, at a branch or
+   * jump. a leader inside another block starts a block of its own
+   * over the same insns, as a jump into the middle of a block does
+   * at run time, so every block ends where the interpreter moves
+   * on to the next one */
+  std::map<uint32_t, basicBlock*> bbs;
+  for(uint32_t l : leaders) {
+    if(basicBlock::globalFindBlock(l) != nullptr) {
+      continue;
+    }
+    uint32_t term = l;
+    bool ended = false;
+    for(; decoded.count(term); term += 4) {
+      if(isBranchOrJump(insnAt(term))) {
+	ended = true;
+	break;
+      }
+    }
+    if(not(ended) or not(decodes(insnAt, l, term))) {
+      continue;
+    }
+    basicBlock *bb = new basicBlock(l);
+    for(uint32_t pc = l; pc <= term; pc += 4) {
+      bb->addIns(insnAt(pc), pc);
+    }
+    bb->setTermAddr(term);
+    bb->setReadOnly();
+    bbs[l] = bb;
+  }
+  blocks += bbs.size();
+
+  /* every static edge counts once so branch weights and the icnt
+   * spanning tree see a flat profile */
+  for(auto &p : bbs) {
+    basicBlock *bb = p.second;
+    uint32_t term = bb->vecIns.back().second, insn = bb->vecIns.back().first;
+    uint32_t target = 0;
+    std::vector<uint32_t> succs;
+    if(isDirectBranchOrJump(insn, term, target)) {
+      if(is_jal(insn) and hleLookup(target) >= 0) {
+	target = term + 4;
+      }
+      succs.push_back(target);
+      if(is_branch(insn)) {
+	succs.push_back(term + 4);
+      }
+    }
+    for(uint32_t pc : succs) {
+      auto it = bbs.find(pc);
+      if(it == bbs.end() or bb->edgeCnts.count(pc)) {
+	continue;
+      }
+      bb->edgeCnts[pc] = 1;
+      bb->totalEdges++;
+      bb->addSuccessor(it->second);
+    }
+    bb->inscnt = bb->getNumIns();
+  }
+
+  /* position independent code for the host, the same cpu and
+   * features the jit uses */
+  std::string err, features;
+  std::string triple = llvm::sys::getProcessTriple();
+  const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, err);
+  if(target == nullptr) {
+    std::cerr << "no target for " << triple << " : " << err << "\n";
+    return;
+  }
+  for(const std::string &f : regionCFG::hostFeatures()) {
+    features += (features.empty() ? "" : ",") + f;
+  }
+  std::unique_ptr<llvm::TargetMachine> tm(target->createTargetMachine(triple, regionCFG::hostCPU(), features,
+								      llvm::TargetOptions(),
+								      llvm::Reloc::PIC_, llvm::None,
+								      globals::regionOptLevel));
+  llvm::Module *m = new llvm::Module("rv32_aot", globalContext);
+  m->setDataLayout(tm->createDataLayout());
+  m->setTargetTriple(triple);
+
+  /* a region per head, everything reachable without running into
+   * another head or an insn regions don't compile */
+  bool fuseCFGs = globals::fuseCFGs;
+  uint64_t codeCacheKB = globals::codeCacheKB;
+  globals::fuseCFGs = false;
+  globals::codeCacheKB = 0;
+  regionCFG::sharedModule = m;
+  for(uint32_t h : heads) {
+    auto hit = bbs.find(h);
+    if(hit == bbs.end() or hit->second->hasmonitor) {
+      continue;
+    }
+    basicBlock *head = hit->second;
+    functions += funcs.count(h);
+    std::vector<basicBlock*> path = {head};
+    std::set<basicBlock*> seen = {head};
+    for(size_t i = 0; i < path.size(); i++) {
+      for(basicBlock *nbb : path[i]->succs) {
+	if(heads.count(nbb->getEntryAddr()) or nbb->hasmonitor) {
+	  continue;
+	}
+	if(seen.insert(nbb).second) {
+	  path.push_back(nbb);
+	}
+      }
+    }
+    /* buildCFG takes a lone block for a loop on itself */
+    if(path.size() == 1 and head->succs.count(head) == 0) {
+      regionsRejected++;
+      continue;
+    }
+    for(basicBlock *bb : path) {
+      bb->cfgInRegions.insert(head);
+    }
+    head->bbRegions.push_back(path);
+    if(head->compileRegions()) {
+      regionsCompiled++;
+    }
+    else {
+      regionsRejected++;
+    }
+  }
+  regionCFG::sharedModule = nullptr;
+  globals::fuseCFGs = fuseCFGs;
+  globals::codeCacheKB = codeCacheKB;
+
+  defineTables(m, objectKey(text, s));
+  std::string errs;
+  llvm::raw_string_ostream OS(errs);
+  if(llvm::verifyModule(*m, &OS)) {
+    std::cerr << OS.str();
+    die();
+  }
+  std::string objName = soName + ".o";
+  {
+    std::error_code ec;
+    llvm::raw_fd_ostream out(objName, ec, llvm::sys::fs::OF_None);
+    if(ec) {
+      std::cerr << "can't write " << objName << " : " << ec.message() << "\n";
+      delete m;
+      return;
+    }
+    llvm::legacy::PassManager pm;
+    if(tm->addPassesToEmitFile(pm, out, nullptr, llvm::CGFT_ObjectFile)) {
+      std::cerr << "can't emit objects for " << triple << "\n";
+      delete m;
+      return;
+    }
+    pm.run(*m);
+  }
+  delete m;
+  std::string cmd = "cc -shared -o '" + soName + "' '" + objName + "'";
+  int rc = std::system(cmd.c_str());
+  unlink(objName.c_str());
+  if(rc != 0) {
+    std::cerr << "can't link " << soName << " (" << cmd << ")\n";
+    return;
+  }
+  std::cerr << "translated " << elfName << " : "
+	    << functions << " functions, "
+	    << blocks << " blocks, "
+	    << regionsCompiled << " regions compiled, "
+	    << regionsRejected << " rejected, "
+	    << regionCFG::sharedRelocs.size() << " relocations, wrote "
+	    << soName << "\n";
+}
+
+void aot::load(const std::string &soName, const std::string &elfName,
+	       state_t *s) {
+  textRanges text;
+  std::set<uint32_t> funcs;
+  if(not(readElf(elfName, text, funcs))) {
+    std::cerr << "can't read " << elfName << " for " << soName << "\n";
+    return;
+  }
+  /* never unloaded, regions dropped later leave their code behind */
+  void *so = dlopen(soName.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if(so == nullptr) {
+    std::cerr << "can't load " << soName << " : " << dlerror() << "\n";
+    return;
+  }
+  const char *key = reinterpret_cast<const char*>(dlsym(so, keySym));
+  const char *regions = reinterpret_cast<const char*>(dlsym(so, regionsSym));
+  const char *osr = reinterpret_cast<const char*>(dlsym(so, osrSym));
+  const uint32_t *ids = reinterpret_cast<const uint32_t*>(dlsym(so, relocIdsSym));
+  const uint64_t *nRelocs = reinterpret_cast<const uint64_t*>(dlsym(so, numRelocsSym));
+  uint64_t *relocs = reinterpret_cast<uint64_t*>(dlsym(so, regionCFG::relocTable));
+  if(key == nullptr or regions == nullptr or osr == nullptr or
+     ids == nullptr or nRelocs == nullptr or relocs == nullptr) {
+    std::cerr << soName << " wasn't written by --aot\n";
+    dlclose(so);
+    return;
+  }
+  if(objectKey(text, s) != key) {
+    std::cerr << soName << " was translated from other text, for another host "
+	      << "or with other code generation flags\n";
+    dlclose(so);
+    return;
+  }
+
+  std::map<uint32_t, std::vector<uint32_t>> sideEntries;
+  std::istringstream osrIn(osr);
+  osrIn >> std::hex;
+  uint32_t h = 0, e = 0;
+  uint64_t n = 0;
+  while(osrIn >> h >> n) {
+    std::vector<uint32_t> &v = sideEntries[h];
+    for(uint64_t i = 0; i < n and (osrIn >> e); i++) {
+      v.push_back(e);
+    }
+  }
+
+  std::istringstream in(regions);
+  regionProfile::read(in, soName, s, [&](basicBlock *head, std::vector<basicBlock*> &path) {
+      std::string name = "cfg_" + toStringHex(head->getEntryAddr());
+      void *entry = dlsym(so, name.c_str());
+      void *body = globals::chainRegions ? dlsym(so, (name + "_body").c_str()) : nullptr;
+      if(entry == nullptr or (globals::chainRegions and body == nullptr)) {
+	return false;
+      }
+      std::vector<basicBlock*> osrBlocks;
+      for(uint32_t pc : sideEntries[head->getEntryAddr()]) {
+	basicBlock *bb = basicBlock::globalFindBlock(pc);
+	if(bb == nullptr) {
+	  return false;
+	}
+	osrBlocks.push_back(bb);
+      }
+      regionCFG *r = new regionCFG();
+      r->bindShared(head, path, osrBlocks, reinterpret_cast<compiledCFG>(entry), body);
+      return true;
+    }, regionsLoaded, regionsNotLoaded);
+
+  /* a bound region only refers to its own blocks, all rebuilt. an
+   * entry nothing resolves belongs to a region that wasn't bound
+   * and whose code never runs */
+  for(uint64_t i = 0; i < *nRelocs; i++) {
+    void *p = regionCFG::relocTarget(static_cast<hostReloc>(ids[2*i]), ids[2*i+1]);
+    relocs[i] = reinterpret_cast<uint64_t>(p);
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef __AOT_HH__
+#define __AOT_HH__
+
+#include <cstdint>
+#include <string>
+
+struct state_t;
+
+/* ahead of time translation : recovers the static cfg of a
+ * loaded binary from its function symbols and the targets of its
+ * direct branches, compiles a region for every function entry and
+ * every call return point into one module and links it into a
+ * host shared object. host addresses the code needs (blocks,
+ * chain slots, counters, rv32_hle) are loaded from a table in the
+ * object that load fills in.
+ *
+ * a later run given the object with --loadAot checks it was
+ * translated from the same text for the same host target and
+ * code generation flags, binds its regions before dispatch starts
+ * and interprets whatever the static cfg missed (indirect
+ * targets, code behind an ecall) */
+class aot {
+public:
+  static uint64_t functions;
+  static uint64_t blocks;
+  static uint64_t regionsCompiled;
+  static uint64_t regionsRejected;
+  static uint64_t regionsLoaded;
+  static uint64_t regionsNotLoaded;
+  static void translate(const std::string &elfName, state_t *s,
+			const std::string &soName);
+  static void load(const std::string &soName, const std::string &elfName,
+		   state_t *s);
+};
+
+#endif
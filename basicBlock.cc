@@ -15,6 +15,8 @@
 
 #include "globals.hh"
 #include "simPoints.hh"
+#include "memProtect.hh"
+#include "regionSched.hh"
 
 uint64_t basicBlock::cfgCnt = 0;
 
@@ -122,6 +124,75 @@ void basicBlock::dropAllBBs() {
   globals::regionFinder->disableRegionCollection();
 }
 
+size_t basicBlock::invalidateCode(uint32_t lo, uint32_t hi, uint32_t pc) {
+  std::set<basicBlock*> nuke;
+  for(auto &p : bbMap) {
+    basicBlock *bb = p.second;
+    uint32_t last = bb->vecIns.empty() ? bb->entryAddr : bb->vecIns.back().second;
+    if(bb->entryAddr < hi and (last+4) > lo) {
+      nuke.insert(bb);
+    }
+  }
+  if(nuke.empty()) {
+    return 0;
+  }
+  /* compiled regions only reference their own blocks */
+  regionCFG::dropRegionsWith(nuke);
+  globals::regionFinder->clear();
+
+  for(basicBlock *bb : nuke) {
+    for(basicBlock *pbb : bb->preds) {
+      if(nuke.find(pbb) == nuke.end()) {
+	pbb->succs.erase(bb);
+	pbb->succsMap.erase(bb->entryAddr);
+      }
+    }
+    for(basicBlock *sbb : bb->succs) {
+      if(nuke.find(sbb) == nuke.end()) {
+	sbb->preds.erase(bb);
+      }
+    }
+    bbMap.erase(bb->entryAddr);
+    for(const auto &i : bb->vecIns) {
+      auto it = insMap.find(i.second);
+      if(it != insMap.end() and it->second == bb) {
+	insMap.erase(it);
+      }
+      auto cit = insInBBCnt.find(i.second);
+      if(cit != insInBBCnt.end() and --(cit->second) == 0) {
+	insInBBCnt.erase(cit);
+      }
+    }
+  }
+  /* scrub pending regions that name a dead block */
+  for(auto &p : bbMap) {
+    basicBlock *bb = p.second;
+    for(basicBlock *dbb : nuke) {
+      bb->cfgInRegions.erase(dbb);
+    }
+    bool stale = false;
+    for(const auto &r : bb->bbRegions) {
+      for(basicBlock *rbb : r) {
+	stale |= (nuke.find(rbb) != nuke.end());
+      }
+    }
+    if(stale) {
+      bb->bbRegions.clear();
+      bb->bbRegionCounts.clear();
+    }
+  }
+  if(nuke.find(globals::cBB) != nuke.end()) {
+    globals::cBB = globalFindBlock(pc);
+    if(globals::cBB == nullptr) {
+      globals::cBB = new basicBlock(pc);
+    }
+  }
+  for(basicBlock *bb : nuke) {
+    delete bb;
+  }
+  return nuke.size();
+}
+
 void basicBlock::setReadOnly() {
   if(not(readOnly)) {
     readOnly = true;
@@ -130,7 +201,8 @@ void basicBlock::setReadOnly() {
       hasjr |= is_jr(insn);
       hasjalr |= is_jalr(insn);
       hasjal |= is_jal(insn);
-      hasmonitor |= is_monitor(insn);
+      /* fence.i is never compiled, keep it out of augmented regions too */
+      hasmonitor |= is_monitor(insn) or is_fencei(insn);
     }
     if(cfgCplr) {
       cfgCplr=nullptr;
@@ -198,6 +270,7 @@ void basicBlock::addIns(uint32_t inst, uint32_t addr) {
 #endif
     insMap[addr] = this;
     insInBBCnt[addr]++;
+    trackCodePage(addr);
     
     //if(insInBBCnt[addr] > 1) {
     //std::cerr << *this;
@@ -433,6 +506,42 @@ void basicBlock::addRegion(const std::vector<basicBlock*> &region) {
   }
 }
 
+bool basicBlock::compileRegions() {
+  cfgCplr = new regionCFG();
+  double now = timestamp();
+  if(cfgCplr->buildCFG(bbRegions)) {	  
+    now = timestamp() - now;
+#if 0
+    std::cout << now << " seconds to compile with "
+	      << cfgCplr->countInsns() << " insns and "
+	      << cfgCplr->countBBs() << " basic blocks\n";
+
+    std::set<basicBlock*> ss;
+    for(const auto &bbt : bbRegions) {
+      for(const auto &bb : bbt){
+	ss.insert(bb);
+      }
+    }
+    for(auto bb : ss) {
+      std::cout << std::hex
+		<< bb->getEntryAddr()
+		<< std::dec
+		<< "\n";
+    }
+
+    fflush(nullptr);
+#endif
+    bbRegions.clear();
+    bbRegionCounts.clear();
+    hasRegion = true;
+    regionCFG::evictColdRegions(regionCFG::fuse(cfgCplr));
+    return true;
+  }
+  delete cfgCplr;
+  cfgCplr = nullptr;
+  return false;
+}
+
 bool basicBlock::executeJIT(state_t *s) {
   std::vector<basicBlock*> bbRegion;
   bool gotRegion = false;
@@ -462,38 +571,7 @@ bool basicBlock::executeJIT(state_t *s) {
     addRegion(bbRegion);
     if(enoughRegions() and canCompile) {
       if(globals::enableCFG) {
-	cfgCplr = new regionCFG();
-	double now = timestamp();
-	if(cfgCplr->buildCFG(bbRegions)) {	  
-	  now = timestamp() - now;
-#if 0
-	  std::cout << now << " seconds to compile with "
-		    << cfgCplr->countInsns() << " insns and "
-		    << cfgCplr->countBBs() << " basic blocks\n";
-
-	  std::set<basicBlock*> ss;
-	  for(const auto &bbt : bbRegions) {
-	    for(const auto &bb : bbt){
-	      ss.insert(bb);
-	    }
-	  }
-	  for(auto bb : ss) {
-	    std::cout << std::hex
-		      << bb->getEntryAddr()
-		      << std::dec
-		      << "\n";
-	  }
-
-	  fflush(nullptr);
-#endif
-	  bbRegions.clear();
-	  bbRegionCounts.clear();
-	  hasRegion = true;
-	}
-	else {
-	  delete cfgCplr;
-	  cfgCplr = nullptr;
-	}
+	regionSched::submit(this);
       }
     }
     else {
@@ -505,12 +583,18 @@ bool basicBlock::executeJIT(state_t *s) {
     }
   }
   
+  regionSched::poll();
   s->oldpc = s->pc;
   
-  if(hasRegion and not(globals::regionFinder->collectionEnabled())) {
-    if(cfgCplr)  {
-      nBB = cfgCplr->run(s);
-    }
+  regionCFG *ran = nullptr;
+  if(hasRegion and cfgCplr) {
+    ran = cfgCplr;
+    nBB = cfgCplr->run(s);
+  }
+  else if(osrCfg) {
+    ran = osrCfg;
+    regionCFG::osrRuns++;
+    nBB = osrCfg->run(s);
   }
   else {
     nBB = this->run(s);
@@ -519,6 +603,15 @@ bool basicBlock::executeJIT(state_t *s) {
   if(nBB == nullptr) {
     nBB = new basicBlock(s->pc, globals::cBB);
   }
+
+  /* compiled code runs while traces are recorded, they take
+   * in its blocks */
+  if(ran) {
+    globals::regionFinder->skipRegion(this, globals::cBB, nBB, ran->blocks);
+    if(ran == cfgCplr and cfgCplr->growthPending()) {
+      regionCFG::grow(cfgCplr);
+    }
+  }
   
   if(not(nBB->hasRegion) and globals::cBB) {
     globals::regionFinder->updateRegionHeads(nBB, globals::cBB);
@@ -529,6 +622,10 @@ bool basicBlock::executeJIT(state_t *s) {
 
 
 basicBlock::~basicBlock() {
+  regionSched::remove(this);
+  if(osrCfg) {
+    osrCfg->osrBlocks.erase(this);
+  }
   if(cfgCplr)
     delete cfgCplr;
 }
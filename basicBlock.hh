@@ -30,6 +30,9 @@ private:
   friend class compile;
   friend class region;
   friend class regionCFG;
+  friend class regionSched;
+  friend class regionProfile;
+  friend class aot;
   struct orderBasicBlocks {
     bool operator() (const basicBlock *a, const basicBlock *b) const {
       return a->getEntryAddr() < b->getEntryAddr();
@@ -46,10 +49,15 @@ private:
   std::map<uint32_t, uint32_t> bbRegionCounts; 
   std::vector <std::vector<basicBlock*>>bbRegions;
   regionCFG *cfgCplr = nullptr;
+  /* compiled region with a side entry at this block */
+  regionCFG *osrCfg = nullptr;
   uint32_t termAddr=0;
   bool readOnly=false;
   bool hasjr=false, hasjal=false, hasjalr = false, hasmonitor=false;
   uint64_t totalEdges = 0;
+  /* backward branches seen into this block, and the trace
+   * length limit region recording uses for it */
+  size_t headCount = 0, traceLimit = 0;
   insContainer vecIns;
   std::map<uint32_t, uint64_t> edgeCnts;
   static bool canCompileRegion(std::vector<basicBlock*> &region);
@@ -59,12 +67,14 @@ private:
 public:
   static void dropAllBBs();
   static void dumpCFG();
+  static size_t invalidateCode(uint32_t lo, uint32_t hi, uint32_t pc);
   void report(std::string &s, uint64_t icnt) override;
   void info() override;
   basicBlock* run(state_t *s) override;
   static bool validPath(std::vector<basicBlock*> &rpath);
   void addRegion(const std::vector<basicBlock*> &region);
   bool enoughRegions() const;
+  bool compileRegions();
   basicBlock* split(uint32_t nEntryAddr);
   void setReadOnly();
   void print() const;
@@ -113,6 +123,13 @@ public:
     }
     return static_cast<double>(it->second) / (totalEdges==0 ? 1 : totalEdges);
   }
+  uint64_t edgeCount(uint32_t pc) const {
+    const auto it = edgeCnts.find(pc);
+    return it == edgeCnts.end() ? 0 : it->second;
+  }
+  uint64_t getTotalEdges() const {
+    return totalEdges;
+  }
   size_t getNumIns() const {
     return vecIns.size();
   }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ostream>
 #include <fstream>
 
@@ -21,7 +22,7 @@ void cfgBasicBlock::addWithInCFGEdges(regionCFG *cfg) {
   insn_j *j = nullptr;
   insn_jal *jal = nullptr;
 
-  std::map<uint32_t,cfgBasicBlock*>::iterator mit0,mit1;
+  std::unordered_map<uint32_t,cfgBasicBlock*>::iterator mit0,mit1;
   uint32_t tAddr=~0,ntAddr=~0;
 
   /* this is crappy code */
@@ -125,10 +126,8 @@ void cfgBasicBlock::addSuccessor(cfgBasicBlock *s) {
 }
 
 void cfgBasicBlock::delSuccessor(cfgBasicBlock *s) {
-  std::set<cfgBasicBlock*>::iterator sit = succs.find(s);
-  succs.erase(sit);
-  sit = s->preds.find(this);
-  s->preds.erase(sit);
+  succs.remove(s);
+  s->preds.remove(this);
 }
 
 void cfgBasicBlock::addPhiNode(gprPhiNode *phi) {
@@ -163,11 +162,33 @@ void cfgBasicBlock::addPhiNode(icntPhiNode *phi) {
   if(icntPhis[0])
     delete phi;
   else {
+    phi->setBlock(this);
     phiNodes.push_back(phi);
     icntPhis[0] = phi;
   }
 }
 
+double cfgBasicBlock::edgeFreq(const cfgBasicBlock *succ) const {
+  if(bb == nullptr) {
+    /* entry block, side entries are cold next to the head */
+    return (succ == succs[0]) ? succ->execFreq() : 0.0;
+  }
+  if(succ->bb == bb) {
+    /* fall through between halves of a split block */
+    return execFreq();
+  }
+  return execFreq() * bb->edgeWeight(succ->getEntryAddr());
+}
+
+std::vector<cfgBasicBlock*> cfgBasicBlock::succsByFreq() const {
+  std::vector<cfgBasicBlock*> s(succs.begin(), succs.end());
+  std::stable_sort(s.begin(), s.end(),
+		   [this](const cfgBasicBlock *a, const cfgBasicBlock *b) {
+		     return succCount(a->getEntryAddr()) > succCount(b->getEntryAddr());
+		   });
+  return s;
+}
+
 
 bool cfgBasicBlock::has_jr_jalr() {
   for(size_t i = 0; i < insns.size(); i++) {
@@ -293,9 +314,8 @@ cfgBasicBlock* cfgBasicBlock::splitBB(uint32_t splitpc) {
   /* attribute all successors to sbb */
   for(cfgBasicBlock *nbb : succs) {
     //std::cout << "succ @ " << std::hex <<  nbb->getEntryAddr() << std::dec << "\n";
-    auto it = nbb->preds.find(this);
-    assert(it != nbb->preds.end());
-    nbb->preds.erase(it);
+    assert(nbb->preds.count(this));
+    nbb->preds.remove(this);
     sbb->addSuccessor(nbb);
   }
   succs.clear();
@@ -452,7 +472,12 @@ void cfgBasicBlock::traverseAndRename(regionCFG *cfg){
   /* this only gets called for the entry block */
   llvmRegTables regTbl(cfg);
   for(size_t i = 0; i < 32; i++) {
-    if(cfg->allGprRead[i] or not(cfg->gprDefinitionBlocks[i].empty())) {
+    if(cfg->gprArgs[i]) {
+      /* chained regions pass these in host registers, exits
+       * hand them on whether the region touches them or not */
+      regTbl.gprTbl[i] = cfg->gprArgs[i];
+    }
+    else if(cfg->allGprRead[i] or not(cfg->gprDefinitionBlocks[i].empty())) {
       regTbl.loadGPR(i);
     }
   }
@@ -469,16 +494,28 @@ void cfgBasicBlock::traverseAndRename(regionCFG *cfg){
   if(globals::countInsns) {
     regTbl.initIcnt();
   }
+  cfg->initStackSlots(regTbl);
 
   //lBB->dump();
 
   termRegTbl.copy(regTbl);
+  if(succs.size() == 1) {
+    cfg->myIRBuilder->CreateBr(succs[0]->lBB);
+  }
+  else {
+    /* side entries, run() was called with pc at one of them */
+    llvm::Value *vZ = llvm::ConstantInt::get(cfg->type_int32, 0);
+    llvm::Value *vPC = cfg->myIRBuilder->MakeLoad(cfg->myIRBuilder->MakeGEP(cfg->blockArgMap["pc"], vZ), "entrypc");
+    cfg->setTBAA(vPC, cfg->tbaaExit);
+    llvm::SwitchInst *sw = cfg->myIRBuilder->CreateSwitch(vPC, succs[0]->lBB, succs.size() - 1);
+    for(size_t i = 1, n = succs.size(); i < n; i++) {
+      sw->addCase(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*cfg->Context), succs[i]->getEntryAddr()),
+		  succs[i]->lBB);
+    }
+  }
+  /* pre-order traversal */
   for(auto nBlock : dtree_succs) {
-    /* iterate over instructions */
-    cfg->myIRBuilder->CreateBr(nBlock->lBB);
-    /* pre-order traversal */
     nBlock->traverseAndRename(cfg, regTbl);
-    break;
   }
 }
 
@@ -496,6 +533,19 @@ void cfgBasicBlock::patchUpPhiNodes(regionCFG *cfg) {
 
 void cfgBasicBlock::traverseAndRename(regionCFG *cfg, llvmRegTables prevRegTbl) {
   llvmRegTables regTbl(prevRegTbl);
+  /* known guest memory only carries over from the idom when it is
+   * the sole predecessor, and its stores may be read on other paths */
+  if(preds.size() != 1) {
+    regTbl.memTbl.clear();
+  }
+  for(guestMemVal &m : regTbl.memTbl) {
+    m.st = nullptr;
+  }
+  if(preds.size() != 1) {
+    for(size_t i = 0, n = regTbl.slotDirty.size(); i < n; i++) {
+      regTbl.slotDirty[i] = cfg->stackSlots[i].stored;
+    }
+  }
 
   /* this gets called for all other blocks block */
   cfg->myIRBuilder->SetInsertPoint(lBB);
@@ -516,7 +566,14 @@ void cfgBasicBlock::traverseAndRename(regionCFG *cfg, llvmRegTables prevRegTbl)
   //bb->print();
 
   if(globals::countInsns) {
-    regTbl.incrIcnt(insns.size());
+    if(not(globals::deferIcnt)) {
+      regTbl.incrIcnt(insns.size());
+    }
+    else if(icntPhis[0] == nullptr) {
+      /* no join, the only predecessor is the idom */
+      assert(preds.size() == 1);
+      regTbl.incrIcnt((*preds.begin())->icntEdgeIncr(this));
+    }
   }
 
   if(globals::simPoints and insns.size()) {
@@ -533,8 +590,14 @@ void cfgBasicBlock::traverseAndRename(regionCFG *cfg, llvmRegTables prevRegTbl)
   /* generate code for each instruction */
   for(size_t i = 0, n=insns.size(); i < n; i++) {
     /* branch delay means we need to skip inst */
+    regTbl.curSlot = stackSlotOf.empty() ? -1 : stackSlotOf[i];
+    if(cfg->diSub) {
+      cfg->myIRBuilder->SetCurrentDebugLocation(llvm::DILocation::get(*cfg->Context, insns[i]->getAddr(), 0, cfg->diSub));
+    }
     insns[i]->codeGen(this, regTbl);
   }
+  regTbl.curSlot = -1;
+  cfg->myIRBuilder->SetCurrentDebugLocation(llvm::DebugLoc());
 
   termRegTbl.copy(regTbl);
   
@@ -12,8 +12,11 @@ bool compile::canCompileInstr(uint32_t inst) {
 
   switch(opcode)
     {
-    case 0x3:  /* loads */
     case 0xf:  /* fence - there's a bunch of 'em */
+      /* fence.i ends regions so stale code is dropped before
+       * the following insns run */
+      return not(is_fencei(inst));
+    case 0x3:  /* loads */
     case 0x13: /* reg + imm insns */
     case 0x23: /* stores */
     case 0x37: /* lui */
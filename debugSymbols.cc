@@ -2,146 +2,185 @@
 #include <string>  // for string
 
 #ifdef ENABLE_DEBUG
+#include <algorithm>
+#include <sstream>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Object/ELFObjectFile.h>
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include "helper.hh"
+
 debugSymDB *debugSymDB::theInstance = nullptr;
+double debugSymDB::symbolizeTime = 0.0;
+uint64_t debugSymDB::lookups = 0;
 
-debugSymDB::debugSymDB() {
-  b = 0;
-  syms = 0;
-  initd = false;
-}
+debugSymDB::debugSymDB() {}
 
 debugSymDB::~debugSymDB() {
-#ifdef __linux__
-  if(initd) {
-    free(syms);
-    bfd_close(b);
-  }
-  for(std::map<uint32_t, dbentry_t>::iterator mit = dbgMap.begin();
-      mit != dbgMap.end(); mit++) {
-    dbentry_t &d = mit->second;
-    free(d.file);
-    free(d.func);
-  }
-#endif
-  theInstance = 0;
+  theInstance = nullptr;
 }
 
 debugSymDB *debugSymDB::getInstance() {
-#ifdef __linux__
-  if(theInstance == 0) {
+  if(theInstance == nullptr) {
     theInstance = new debugSymDB();
   }
-#endif
   return theInstance;
 }
 
-/* adapted from binutils addr2line */
+/* nothing is read until a report asks for a pc */
 void debugSymDB::pinit(const char *exe) {
-#ifdef __linux__
-  long storage=0,symcount=0;
-  bool dynamic = false;
-  char **matching = 0;
-  if(initd)
-    return;
-  b = bfd_openr(exe, nullptr);
-  if(b==nullptr) {
-    printf("=>bfd: couldn't open %s<=\n", exe);
-    exit(-1);
-  }
-  b->flags |= BFD_DECOMPRESS;
-  if(bfd_check_format(b, bfd_archive)) {
-    printf("=>bfd: bad format<=\n");
-    exit(-1);
-  }
-  /* This is required */
-  if(!bfd_check_format_matches(b, bfd_object, &matching)) {
-    exit(-1);
-  }
-  if((bfd_get_file_flags(b)&HAS_SYMS) == 0) {
-    printf("=>bfd: no symbols<=\n");
-    exit(-1);
-  }
-  storage = bfd_get_symtab_upper_bound(b);
-  if(storage == 0) {
-    storage = bfd_get_dynamic_symtab_upper_bound(b);
-    dynamic = true;
-  }
-  if(storage < 0) {
-    printf("=>bfd: storage less than zero<=\n");
-    exit(-1);
-  }
-  syms = (asymbol**)malloc(storage);
-  if(dynamic) 
-    symcount = bfd_canonicalize_dynamic_symtab (b, syms);
-  else 
-    symcount = bfd_canonicalize_symtab (b, syms);
-
-  if(symcount <= 0) {
-    printf("=>bfd: found zero symbols<=\n");
-    exit(-1);
-  }
-  buildDB();
-#endif
-  initd=true;
+  this->exe = exe;
+  initd = true;
 }
 
 void debugSymDB::lookup(uint32_t addr, std::string &s) {
-  return theInstance->plookup(addr,s);
+  if(theInstance == nullptr or not(theInstance->initd)) {
+    return;
+  }
+  double t0 = timestamp();
+  theInstance->plookup(addr,s);
+  symbolizeTime += timestamp() - t0;
+  lookups++;
 }
+
 void debugSymDB::init(const char *exe) {
-#ifdef __linux__
   debugSymDB *d = getInstance();
   if(!d->initd)
     d->pinit(exe);
-#endif
 }
 
 void debugSymDB::release() {
-#ifdef __linux__
   delete theInstance;
-  theInstance = 0;
-#endif
+  theInstance = nullptr;
+}
+
+uint32_t debugSymDB::intern(const std::string &name) {
+  auto it = nameIds.find(name);
+  if(it != nameIds.end()) {
+    return it->second;
+  }
+  uint32_t id = names.size();
+  names.push_back(name);
+  nameIds[name] = id;
+  return id;
+}
+
+const debugSymDB::interval_t *debugSymDB::below(const std::vector<interval_t> &v, uint32_t addr) {
+  auto it = std::upper_bound(v.begin(), v.end(), interval_t{addr, addr, 0});
+  if(it == v.begin()) {
+    return nullptr;
+  }
+  return &(*(--it));
+}
+
+const debugSymDB::interval_t *debugSymDB::find(const std::vector<interval_t> &v, uint32_t addr) {
+  const interval_t *i = below(v, addr);
+  return (i and addr < i->hi) ? i : nullptr;
 }
 
 void debugSymDB::plookup(uint32_t addr, std::string &s) {
-#ifdef __linux__
-  std::map<uint32_t,dbentry_t>::iterator mit = dbgMap.find(addr);
-  if(mit != dbgMap.end()) {
-    dbentry_t &d= mit->second;
-    std::stringstream ss;
-    ss << "func " << d.func << " @ line " << d.line << "\n";
-    s += ss.str();
+  if(not(built)) {
+    buildDB();
   }
-#endif
+  const interval_t *f = find(funcs, addr);
+  const interval_t *l = find(lines, addr);
+  std::stringstream ss;
+  if(f != nullptr) {
+    ss << "func " << names.at(f->val);
+  }
+  else if((f = below(labels, addr)) != nullptr) {
+    ss << "func " << names.at(f->val) << "+0x" << std::hex << (addr - f->lo) << std::dec;
+  }
+  else {
+    return;
+  }
+  ss << " @ line " << (l ? l->val : 0) << "\n";
+  s += ss.str();
 }
 
 void debugSymDB::buildDB() {
-#ifdef __linux__
-  for(asection *p = b->sections; p != nullptr; p=p->next) {
-    if((bfd_section_flags(p) & SEC_ALLOC) == 0)
+  built = true;
+  auto ob = llvm::object::ObjectFile::createObjectFile(exe);
+  if(not(ob)) {
+    llvm::consumeError(ob.takeError());
+    std::cerr << "couldn't open " << exe << " for symbols\n";
+    return;
+  }
+  llvm::object::ObjectFile *obj = ob->getBinary();
+
+  /* function symbols, a symbol without a size runs to the next one */
+  bool isElf = llvm::isa<llvm::object::ELFObjectFileBase>(obj);
+  std::vector<std::pair<interval_t, bool>> syms;
+  for(const llvm::object::SymbolRef &sym : obj->symbols()) {
+    auto type = sym.getType();
+    auto addr = sym.getAddress();
+    auto name = sym.getName();
+    if(not(type) or not(addr) or not(name)) {
+      llvm::consumeError(type.takeError());
+      llvm::consumeError(addr.takeError());
+      llvm::consumeError(name.takeError());
+      continue;
+    }
+    uint32_t lo = static_cast<uint32_t>(*addr);
+    if(*type != llvm::object::SymbolRef::ST_Function) {
+      /* untyped labels in text, without the $x mapping symbols */
+      auto sec = sym.getSection();
+      if(not(sec)) {
+	llvm::consumeError(sec.takeError());
+	continue;
+      }
+      if(*type == llvm::object::SymbolRef::ST_Unknown and
+	 *sec != obj->section_end() and (*sec)->isText() and
+	 not(name->empty()) and not(name->startswith("$"))) {
+	labels.push_back({lo, lo, intern(name->str())});
+      }
+      continue;
+    }
+    uint64_t size = isElf ? llvm::object::ELFSymbolRef(sym).getSize() : 0;
+    uint32_t id = intern(name->str());
+    syms.push_back({{lo, static_cast<uint32_t>(lo + size), id}, size != 0});
+    labels.push_back({lo, lo, id});
+  }
+  std::sort(labels.begin(), labels.end());
+  std::sort(syms.begin(), syms.end(), [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    });
+  for(size_t i = 0, n = syms.size(); i < n; i++) {
+    interval_t f = syms[i].first;
+    if(not(syms[i].second)) {
+      f.hi = (i + 1) < n ? syms[i+1].first.lo : ~0U;
+    }
+    funcs.push_back(f);
+  }
+
+  /* one interval per line table row, rows are address ordered
+   * within a sequence */
+  std::unique_ptr<llvm::DWARFContext> dwarf = llvm::DWARFContext::create(*obj);
+  for(const auto &cu : dwarf->compile_units()) {
+    const llvm::DWARFDebugLine::LineTable *lt = dwarf->getLineTableForUnit(cu.get());
+    if(lt == nullptr) {
       continue;
-    bfd_size_type s = bfd_section_size(p);
-    bfd_vma vma = bfd_section_vma(p);
-    for(uint32_t pc = 0; pc < s; pc+=4) {
-      const char *file=0;
-      const char *func=0;
-      uint32_t line;
-      bfd_find_nearest_line(b, p, syms, pc, &file, &func, &line);
-      if(func) {
-	char *funcstr=0, *filestr=0;
-	funcstr = func ? strdup(func) : strdup("???");
-	filestr = file ? strdup(file) : strdup("???");
-	dbentry_t e{line, filestr, funcstr};
-	dbgMap[vma+pc] = e;
+    }
+    const auto &rows = lt->Rows;
+    for(size_t i = 0; (i + 1) < rows.size(); i++) {
+      if(rows[i].EndSequence) {
+	continue;
+      }
+      uint32_t lo = static_cast<uint32_t>(rows[i].Address.Address);
+      uint32_t hi = static_cast<uint32_t>(rows[i+1].Address.Address);
+      if(hi > lo) {
+	lines.push_back({lo, hi, rows[i].Line});
       }
     }
   }
-#endif
+  std::sort(lines.begin(), lines.end());
 }
 
 
 #else
 
+double debugSymDB::symbolizeTime = 0.0;
+uint64_t debugSymDB::lookups = 0;
+
 void debugSymDB::init(const char *binary) {
   return;
 }
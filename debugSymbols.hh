@@ -5,30 +5,46 @@
 #include <string>   // for string
 
 #ifdef ENABLE_DEBUG
-#include <bfd.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <vector>
+#include <unordered_map>
 
+/* the symbol table and the dwarf line table are read once, on the
+ * first lookup, into address sorted interval vectors with interned
+ * function names. a lookup is a binary search in each, a pc outside
+ * every function is named after the closest text symbol below it */
 class debugSymDB {
 public:
+  static double symbolizeTime;
+  static uint64_t lookups;
   static void init(const char *binary);
   static debugSymDB* getInstance();
   static void lookup(uint32_t addr, std::string &s);
   static void release();
 private:
-  struct dbentry_t {
-    uint32_t line;
-    char* file;
-    char* func;
+  struct interval_t {
+    uint32_t lo;
+    uint32_t hi;
+    /* line number or index into names */
+    uint32_t val;
+    bool operator<(const interval_t &o) const {
+      return lo < o.lo;
+    }
   };
-  bfd *b = nullptr;
+  std::string exe;
   bool initd = false;
-  asymbol **syms = nullptr;
+  bool built = false;
+  std::vector<interval_t> funcs;
+  /* function symbols and untyped text labels (crt0 entry points,
+   * asm routines), by address */
+  std::vector<interval_t> labels;
+  std::vector<interval_t> lines;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, uint32_t> nameIds;
   ~debugSymDB();
+  uint32_t intern(const std::string &name);
   void buildDB();
-  std::map<uint32_t, dbentry_t> dbgMap;
+  static const interval_t *find(const std::vector<interval_t> &v, uint32_t addr);
+  static const interval_t *below(const std::vector<interval_t> &v, uint32_t addr);
   void plookup(uint32_t addr, std::string &s);
   void pinit(const char *exe);
   static debugSymDB *theInstance;
@@ -37,6 +53,8 @@ private:
 #else
 class debugSymDB {
 public:
+  static double symbolizeTime;
+  static uint64_t lookups;
   static void init(const char *binary);
   static debugSymDB* getInstance();
   static void lookup(uint32_t addr, std::string &s);
@@ -0,0 +1,154 @@
+#ifndef __DOMINATORS_HH__
+#define __DOMINATORS_HH__
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/* dominators and dominance frontiers over any block type with
+ * getSuccs()/getPreds() ranges, an int32_t cfgId scratch field,
+ * getIdom(), addDTreeSucc() and a dfrontier vector. regionCFG runs
+ * them on cfgBasicBlocks, tools/domBench on synthetic and recorded
+ * graphs */
+
+/* Implementation from Muchnick and Lengauer-Tarjan TOPLAS
+ * paper (the simple, path compression only, variant). Vague
+ * understanding from Appel. Everything is indexed by dfs number,
+ * 0 is null, so no maps or sets are touched */
+template <typename T>
+class LengauerTarjanDominators {
+private:
+  typedef decltype(std::declval<T*>()->getSuccs().begin()) succIter;
+  const std::vector<T*> &blocks;
+  T *root;
+  int32_t n = 0;
+  std::vector<T*> vertex;
+  std::vector<int32_t> parent, semi, ancestor, label, idom;
+  /* buckets as singly linked lists threaded through bucketNext */
+  std::vector<int32_t> bucketHead, bucketNext;
+  std::vector<int32_t> path;
+
+  void DFS() {
+    std::vector<std::pair<T*, succIter>> stack;
+    root->cfgId = ++n;
+    vertex[n] = root;
+    stack.push_back({root, root->getSuccs().begin()});
+    while(not(stack.empty())) {
+      auto &top = stack.back();
+      if(top.second == top.first->getSuccs().end()) {
+	stack.pop_back();
+	continue;
+      }
+      T *nbb = *(top.second++);
+      if(nbb->cfgId == 0) {
+	nbb->cfgId = ++n;
+	vertex[n] = nbb;
+	parent[n] = top.first->cfgId;
+	stack.push_back({nbb, nbb->getSuccs().begin()});
+      }
+    }
+  }
+  /* these methods are from Lengauer-Tarjan paper
+   * and implement O(m*lg(n)) scheme */
+  void Compress(int32_t v) {
+    path.clear();
+    while(ancestor[ancestor[v]]) {
+      path.push_back(v);
+      v = ancestor[v];
+    }
+    for(auto it = path.rbegin(); it != path.rend(); ++it) {
+      int32_t u = *it, a = ancestor[u];
+      if(semi[label[a]] < semi[label[u]]) {
+	label[u] = label[a];
+      }
+      ancestor[u] = ancestor[a];
+    }
+  }
+  int32_t Eval(int32_t v) {
+    if(ancestor[v] == 0) {
+      return v;
+    }
+    Compress(v);
+    return label[v];
+  }
+
+public:
+  LengauerTarjanDominators(const std::vector<T*> &blocks,
+			   T *root) : blocks(blocks), root(root) {}
+  void operator()() {
+    size_t sz = blocks.size() + 1;
+    vertex.assign(sz, nullptr);
+    parent.assign(sz, 0);
+    ancestor.assign(sz, 0);
+    idom.assign(sz, 0);
+    bucketHead.assign(sz, 0);
+    bucketNext.assign(sz, 0);
+    for(T *bb : blocks) {
+      assert(bb == root or not(bb->getPreds().empty()));
+      bb->cfgId = 0;
+      bb->getIdom() = nullptr;
+    }
+    DFS();
+    semi.resize(n+1);
+    label.resize(n+1);
+    for(int32_t i = 0; i <= n; i++) {
+      semi[i] = label[i] = i;
+    }
+
+    for(int32_t w = n; w > 1; w--) {
+      for(T *pbb : vertex[w]->getPreds()) {
+	if(pbb->cfgId == 0) {
+	  continue;
+	}
+	int32_t u = Eval(pbb->cfgId);
+	if(semi[u] < semi[w]) {
+	  semi[w] = semi[u];
+	}
+      }
+      bucketNext[w] = bucketHead[semi[w]];
+      bucketHead[semi[w]] = w;
+      int32_t p = parent[w];
+      ancestor[w] = p;
+      for(int32_t v = bucketHead[p]; v != 0; v = bucketNext[v]) {
+	/* find ancestor with lowest semidominator */
+	int32_t u = Eval(v);
+	/* the idom is the semidominator, or must be deferred */
+	idom[v] = (semi[u] < semi[v]) ? u : p;
+      }
+      bucketHead[p] = 0;
+    }
+    for(int32_t w = 2; w <= n; w++) {
+      if(idom[w] != semi[w]) {
+	idom[w] = idom[idom[w]];
+      }
+      vertex[w]->getIdom() = vertex[idom[w]];
+      vertex[idom[w]]->addDTreeSucc(vertex[w]);
+    }
+  }
+
+};
+
+template <typename T>
+void computeDominanceFrontiers(const std::vector<T*> &blocks) {
+  for(T *cbb : blocks) {
+    /* only blocks with more than one pred
+     * can update dominance frontiers */
+    if(cbb->getPreds().size() > 1) {
+      for(T *nbb : cbb->getPreds()) {
+	/* iterate back to idom
+	 * adding this node to
+	 * appropriate dominance frontiers */
+	while((nbb != cbb->getIdom())) {
+	  /* the walks for one cbb only ever revisit its last entry */
+	  if(nbb->dfrontier.empty() or nbb->dfrontier.back() != cbb) {
+	    nbb->dfrontier.push_back(cbb);
+	  }
+	  nbb = nbb->getIdom();
+	}
+      }
+    }
+  }
+}
+
+#endif
@@ -11,12 +11,14 @@ class basicBlock;
 class execUnit;
 
 enum class cfgAugEnum {none, head, aggressive, insane};
+enum class osrEnum {none, safe, all};
 
 namespace globals {
   extern int sArgc;
   extern char** sArgv;
   extern bool isMipsEL;
   extern bool countInsns;
+  extern bool deferIcnt;
   extern bool simPoints;
   extern bool replay;
   extern uint64_t simPointsSlice;
@@ -31,20 +33,41 @@ namespace globals {
   extern bool fuseCFGs;
   extern uint64_t nFuses;
   extern uint64_t nAttemptedFuses;
+  extern uint64_t growThresh;
   extern bool enableBoth;
   extern uint32_t enoughRegions;
+  extern double compileBudget;
+  extern uint64_t codeCacheKB;
+  extern bool releaseIR;
+  extern std::string irPipeline;
+  extern std::string hostCPU;
+  extern std::string hostFeatures;
+  extern bool hle;
+  extern uint64_t hleCallCost;
+  extern double hleByteCost;
+  extern bool chainRegions;
   extern bool dumpIR;
+  extern bool loopOpt;
+  extern bool memForward;
+  extern bool promoteStack;
+  extern bool branchWeights;
   extern bool dumpCFG;
   extern bool splitCFGBBs;
   extern std::string blobName;
   extern uint64_t icountMIPS;
   extern cfgAugEnum cfgAug;
+  extern osrEnum osrEntries;
   extern std::string binaryName;
   extern std::set<int> openFileDes;
   extern bool profile;
   extern uint64_t dumpicnt;
   extern uint64_t tohost_addr;
   extern uint64_t fromhost_addr;
+  extern uint32_t lowestLoadAddr;
+  extern bool memGuard;
+  extern bool smc;
+  extern uint64_t nInvalidatedPages;
+  extern uint64_t nInvalidatedBlocks;
   extern std::map<std::string, uint32_t> symtab;
   extern bool log;
   extern std::map<uint32_t, uint64_t> syscall_histo;
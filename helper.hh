@@ -65,12 +65,19 @@ void dbt_backtrace();
 
 double timestamp();
 
+/* a cycle or tick counter, the units differ between hosts */
 inline uint64_t rdtsc(void)  {
+#if defined(__amd64__)
   uint32_t hi=0, lo=0;
-#ifdef __amd64__
   __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
-#endif
   return ( (uint64_t)lo)|( ((uint64_t)hi)<<32 );
+#elif defined(__aarch64__)
+  uint64_t t = 0;
+  __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#else
+  return static_cast<uint64_t>(timestamp() * 1e9);
+#endif
 }
 
 uint32_t update_crc(uint32_t crc, uint8_t *buf, size_t len);
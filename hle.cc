@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <unordered_map>
+
+#include "hle.hh"
+#include "state.hh"
+#include "helper.hh"
+#define ELIDE_LLVM
+#include "globals.hh"
+
+static const char *hleNames[] = {"memcpy", "memmove", "memset", "strlen", "strcmp"};
+static_assert(sizeof(hleNames)/sizeof(hleNames[0]) ==
+	      static_cast<size_t>(hleFunc::numFuncs), "hle name table");
+
+static std::unordered_map<uint32_t, int32_t> hleEntries;
+static uint64_t hleCalls[static_cast<size_t>(hleFunc::numFuncs)] = {0};
+static uint64_t hleBytes[static_cast<size_t>(hleFunc::numFuncs)] = {0};
+static uint64_t hleDeclined[static_cast<size_t>(hleFunc::numFuncs)] = {0};
+
+void initHLE() {
+  hleEntries.clear();
+  if(not(globals::hle)) {
+    return;
+  }
+  for(size_t i = 0; i < static_cast<size_t>(hleFunc::numFuncs); i++) {
+    auto it = globals::symtab.find(hleNames[i]);
+    if(it != globals::symtab.end() and it->second != 0) {
+      hleEntries[it->second] = i;
+    }
+  }
+}
+
+int32_t hleLookup(uint32_t pc) {
+  if(hleEntries.empty()) {
+    return -1;
+  }
+  auto it = hleEntries.find(pc);
+  return it == hleEntries.end() ? -1 : it->second;
+}
+
+/* the host routines see guest memory as one flat buffer, ranges
+ * that run past the top of the 4 GiB window are left to the guest */
+static const uint64_t guestMemTop = 1UL<<32;
+
+static bool inGuestMem(uint32_t a, uint32_t len) {
+  return (static_cast<uint64_t>(a) + len) <= guestMemTop;
+}
+
+extern "C" uint32_t rv32_hle(int32_t fn, uint8_t *mem, uint32_t a0,
+			     uint32_t a1, uint32_t a2, uint32_t *rv,
+			     uint64_t *cost) {
+  uint64_t bytes = 0;
+  bool fits = true;
+  *rv = a0;
+  *cost = 0;
+  switch(static_cast<hleFunc>(fn))
+    {
+    case hleFunc::memcpy:
+      /* memmove is a valid memcpy */
+    case hleFunc::memmove:
+      fits = inGuestMem(a0, a2) and inGuestMem(a1, a2);
+      if(not(fits)) {
+	break;
+      }
+      std::memmove(mem + a0, mem + a1, a2);
+      bytes = a2;
+      break;
+    case hleFunc::memset:
+      fits = inGuestMem(a0, a2);
+      if(not(fits)) {
+	break;
+      }
+      std::memset(mem + a0, a1 & 0xff, a2);
+      bytes = a2;
+      break;
+    case hleFunc::strlen: {
+      const void *z = std::memchr(mem + a0, 0, guestMemTop - a0);
+      fits = (z != nullptr);
+      if(not(fits)) {
+	break;
+      }
+      *rv = reinterpret_cast<const uint8_t*>(z) - (mem + a0);
+      bytes = *rv + 1;
+      break;
+    }
+    case hleFunc::strcmp: {
+      /* newlib returns the difference of the first mismatching
+       * bytes, not just the sign */
+      const uint8_t *x = mem + a0, *y = mem + a1;
+      uint64_t n = guestMemTop - std::max(a0, a1);
+      uint64_t i = 0;
+      while(i < n and x[i] and (x[i] == y[i])) {
+	i++;
+      }
+      fits = (i != n);
+      if(not(fits)) {
+	break;
+      }
+      *rv = static_cast<int32_t>(x[i]) - static_cast<int32_t>(y[i]);
+      bytes = i + 1;
+      break;
+    }
+    default:
+      die();
+    }
+  if(not(fits)) {
+    hleDeclined[fn]++;
+    return 0;
+  }
+  hleCalls[fn]++;
+  hleBytes[fn] += bytes;
+  *cost = globals::hleCallCost + static_cast<uint64_t>(std::ceil(globals::hleByteCost * bytes));
+  return 1;
+}
+
+bool hleCall(state_t *s, uint32_t target) {
+  int32_t fn = hleLookup(target);
+  if(fn < 0) {
+    return false;
+  }
+  uint32_t rv = 0;
+  uint64_t cost = 0;
+  if(not(rv32_hle(fn, s->mem, s->gpr[10], s->gpr[11], s->gpr[12], &rv, &cost))) {
+    return false;
+  }
+  s->gpr[10] = rv;
+  s->icnt += cost;
+  s->pc = s->gpr[1];
+  return true;
+}
+
+void hleReport(std::ostream &out) {
+  for(size_t i = 0; i < static_cast<size_t>(hleFunc::numFuncs); i++) {
+    if(hleCalls[i] == 0 and hleDeclined[i] == 0) {
+      continue;
+    }
+    out << "\t" << hleNames[i] << " emulated "
+	<< hleCalls[i] << " times, "
+	<< hleBytes[i] << " bytes, "
+	<< hleDeclined[i] << " left to the guest\n";
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef __HLE_HH__
+#define __HLE_HH__
+
+#include <cstdint>
+#include <ostream>
+
+struct state_t;
+
+/* high level emulation of guest libc routines : a jal ra to the
+ * entry of one of these symbols runs a host implementation on
+ * guest memory and continues at ra, in the interpreter and in
+ * compiled regions alike. icnt is charged hleCallCost plus
+ * hleByteCost per byte touched instead of the guest insns */
+
+enum class hleFunc {memcpy, memmove, memset, strlen, strcmp, numFuncs};
+
+void initHLE();
+/* hleFunc at entry pc as an int, -1 when pc isn't intercepted */
+int32_t hleLookup(uint32_t pc);
+/* interpreter side, called after a jal has set ra. false leaves
+ * the pc at the guest routine */
+bool hleCall(state_t *s, uint32_t target);
+void hleReport(std::ostream &out);
+
+/* shared by the interpreter and compiled regions, returns 1 with
+ * the new a0 in *rv and the icnt to charge in *cost. returns 0
+ * without touching guest memory when an argument range runs past
+ * the top of guest memory, the guest routine runs instead */
+extern "C" uint32_t rv32_hle(int32_t fn, uint8_t *mem, uint32_t a0,
+			     uint32_t a1, uint32_t a2, uint32_t *rv,
+			     uint64_t *cost);
+
+#endif
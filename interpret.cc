@@ -18,6 +18,8 @@
 #include "saveState.hh"    // for dumpState
 #include "state.hh"        // for state_t, operator<<
 #include "riscv.hh"
+#include "hle.hh"
+#include "memProtect.hh"
 #define ELIDE_LLVM
 #include "globals.hh"      // for cBB, blobName, isMipsEL
 
@@ -304,6 +306,10 @@ void execRiscv(state_t *s) {
 	s->gpr[rd] = s->pc + 4;
       }
       s->pc += jaddr;
+      if(rd == 1) {
+	/* an emulated libc call returns straight to ra */
+	hleCall(s, s->pc);
+      }
       getNextBlock(s);
       break;
     }
@@ -590,6 +596,7 @@ void handle_syscall(state_t *s, uint64_t tohost) {
     }
     case SYS_read: {
       //std::cout << "performing " << buf[3] << " sized read\n";
+      markCodeWritten(buf[2], buf[3]);
       buf[0] = read(buf[1], reinterpret_cast<char*>(s->mem + buf[2]), buf[3]); 
       break;
     }
@@ -623,7 +630,8 @@ void handle_syscall(state_t *s, uint64_t tohost) {
     case SYS_gettimeofday: {
       static_assert(sizeof(struct timeval)==16, "timeval has wrong size");
       struct timeval *tp = reinterpret_cast<struct timeval*>(s->mem + buf[1]);
-      struct timezone *tzp = reinterpret_cast<struct timezone*>(s->mem + buf[2]);
+      /* a null guest tzp must stay null, page 0 is a guard page */
+      struct timezone *tzp = buf[2] ? reinterpret_cast<struct timezone*>(s->mem + buf[2]) : nullptr;
       buf[0] = gettimeofday(tp, tzp);
       break;
     }
@@ -9,6 +9,7 @@
 #include <cstring>
 #include <cassert>
 #include <utility>
+#include <algorithm>
 #include <cstdint>
 #include <list>
 #include <map>
@@ -19,6 +20,7 @@
 
 #define ELIDE_LLVM
 #include "globals.hh"
+#include "memProtect.hh"
 
 
 #ifdef __APPLE__
@@ -129,6 +131,7 @@ void load_elf(const char* fn, state_t *ms) {
       //	<< (p_vaddr + p_memsz)
       //	<< std::dec << "\n";
       
+      globals::lowestLoadAddr = std::min(globals::lowestLoadAddr, p_vaddr);
       memset(mem+p_vaddr, 0, sizeof(uint8_t)*p_memsz);
       memcpy(mem+p_vaddr, (uint8_t*)(buf + p_offset),
 	     sizeof(uint8_t)*p_filesz);
@@ -144,12 +147,7 @@ void load_elf(const char* fn, state_t *ms) {
       bool pgAligned = ((addr & 4095) == 0);
       if(pgAligned) {
 	size = (size / pgSize) * pgSize;
-	void *mpaddr = (void*)(mem+addr);
-	rc = mprotect(mpaddr, size, PROT_READ);
-	if(rc != 0) {
-	  printf("mprotect rc = %d, error(%d) = %s\n", rc, 
-		 errno, strerror(errno));
-	}
+	protectCode(mem, addr, size);
       }
     }
     if (sh32->sh_type & SHT_NOBITS) {
@@ -185,6 +183,7 @@ void load_elf(const char* fn, state_t *ms) {
   WRITE_WORD(0x1010, 0x00028067); //4
   WRITE_WORD(0x1014, ms->pc);
   WRITE_WORD(0x1018, ms->pc);
+  globals::lowestLoadAddr = std::min(globals::lowestLoadAddr, 0x1000U);
 
   ms->pc = 0x1000;
 }
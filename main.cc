@@ -24,6 +24,11 @@
 #include "globals.hh"
 #include "simPoints.hh"
 #include "m1cycles.hh"
+#include "memProtect.hh"
+#include "regionSched.hh"
+#include "hle.hh"
+#include "regionProfile.hh"
+#include "aot.hh"
 
 extern const char* githash;
 int sArgc = -1;
@@ -35,6 +40,7 @@ namespace globals {
   bool isMipsEL = false;
   llvm::CodeGenOpt::Level regionOptLevel = llvm::CodeGenOpt::Aggressive;
   bool countInsns = true;
+  bool deferIcnt = true;
   bool simPoints = false;
   bool replay = false;
   uint64_t simPointsSlice = 0;
@@ -46,17 +52,33 @@ namespace globals {
   bool enableCFG = true;
   bool verbose = false;
   bool ipo = true;
-  bool fuseCFGs = true;
+  bool fuseCFGs = false;
   bool enableBoth = true;
   uint32_t enoughRegions = 5;
+  double compileBudget = 250.0;
+  uint64_t codeCacheKB = 1UL<<16;
+  bool releaseIR = true;
+  std::string irPipeline = "bt";
+  std::string hostCPU;
+  std::string hostFeatures;
+  bool hle = false;
+  uint64_t hleCallCost = 10;
+  double hleByteCost = 1.0;
+  bool chainRegions = false;
   bool dumpIR = false;
+  bool loopOpt = true;
+  bool memForward = true;
+  bool promoteStack = false;
+  bool branchWeights = true;
   bool dumpCFG = false;
   bool splitCFGBBs = true;
   uint64_t nFuses = 0;
   uint64_t nAttemptedFuses = 0;
+  uint64_t growThresh = 0;
   std::string blobName;
   uint64_t icountMIPS = 500;
   cfgAugEnum cfgAug = cfgAugEnum::none;
+  osrEnum osrEntries = osrEnum::safe;
   std::string binaryName;
   std::set<int> openFileDes;
   bool profile = false;
@@ -65,6 +87,11 @@ namespace globals {
   std::map<std::string, uint32_t> symtab;
   uint64_t tohost_addr = 0;
   uint64_t fromhost_addr = 0;
+  uint32_t lowestLoadAddr = ~0U;
+  bool memGuard = true;
+  bool smc = true;
+  uint64_t nInvalidatedPages = 0;
+  uint64_t nInvalidatedBlocks = 0;
   std::map<uint32_t, uint64_t> syscall_histo;
 }
 
@@ -72,6 +99,34 @@ perfmap* perfmap::theInstance = nullptr;
 std::set<regionCFG*> regionCFG::regionCFGs;
 uint64_t regionCFG::icnt = 0;
 uint64_t regionCFG::iters = 0;
+uint64_t regionCFG::exitStores = 0;
+uint64_t regionCFG::exitStoresElided = 0;
+uint64_t regionCFG::memLoadsForwarded = 0;
+uint64_t regionCFG::memLoadsReused = 0;
+uint64_t regionCFG::memStoresElided = 0;
+uint64_t regionCFG::stackSlotsPromoted = 0;
+uint64_t regionCFG::stackOpsPromoted = 0;
+uint64_t regionCFG::stackOpsMaterialized = 0;
+double regionCFG::domTime = 0.0;
+double regionCFG::buildTime = 0.0;
+double regionCFG::optTime = 0.0;
+uint64_t regionCFG::hleCallsEmitted = 0;
+uint64_t regionCFG::regionsBuilt = 0;
+uint64_t regionCFG::arenaBytes = 0;
+double regionCFG::ticksPerSec = 0.0;
+uint64_t regionCFG::codeCacheBytes = 0;
+uint64_t regionCFG::evictions = 0;
+uint64_t regionCFG::recompiles = 0;
+std::set<uint32_t> regionCFG::evictedHeads;
+uint64_t regionCFG::chainExitsEmitted = 0;
+uint64_t regionCFG::osrEntriesEmitted = 0;
+uint64_t regionCFG::osrRuns = 0;
+uint64_t regionCFG::regionsGrown = 0;
+std::unordered_map<uint32_t, void*> regionCFG::chainSlots;
+llvm::Module *regionCFG::sharedModule = nullptr;
+std::vector<std::pair<hostReloc, uint32_t>> regionCFG::sharedRelocs;
+std::map<std::pair<hostReloc, uint32_t>, uint32_t> regionCFG::sharedRelocIds;
+const char *const regionCFG::relocTable = "rv32_aot_relocs";
 std::map<uint32_t, basicBlock*> basicBlock::bbMap;
 std::map<uint32_t, basicBlock*> basicBlock::insMap;
 std::map<uint32_t, uint64_t> basicBlock::insInBBCnt;
@@ -90,11 +145,16 @@ static cfgAugEnum augLevels[4] = {cfgAugEnum::none,
 				  cfgAugEnum::head,
 				  cfgAugEnum::aggressive,
 				  cfgAugEnum::insane};
+
+static osrEnum osrLevels[4] = {osrEnum::none,
+			       osrEnum::safe,
+			       osrEnum::all,
+			       osrEnum::all};
   
 static state_t *s = nullptr;
 int buildArgcArgv(const char *filename, const std::string &sysArgs, char ** &argv);
 
-static jmp_buf jenv;
+static sigjmp_buf jenv;
 
 
 int main(int argc, char *argv[]) {
@@ -124,11 +184,11 @@ int main(int argc, char *argv[]) {
  
   uint8_t *mem = nullptr;
 
-  uint32_t optidx = 3, augidx = 1;
+  uint32_t optidx = 3, augidx = 1, osridx = 1;
   double estart=0,estop=0;
   bool report=false, hash=false, fp_exception=false, replay = false;
   uint64_t max_icnt = 0;
-  std::string sysArgs, filename, simPointsFname;
+  std::string sysArgs, filename, simPointsFname, regionsIn, regionsOut, aotOut, aotIn;
   po::options_description desc("Options");
   po::variables_map vm;
   desc.add_options() 
@@ -139,6 +199,16 @@ int main(int argc, char *argv[]) {
    ("cfg", po::value<bool>(&globals::enableCFG)->default_value(true), "enable cfg-level opt")
    ("dumpicnt", po::value<uint64_t>(&globals::dumpicnt), "dump after n instructions")    
    ("enoughRegions,e", po::value<uint32_t>(&globals::enoughRegions)->default_value(5), "how many times does each region need to get executed")    
+   ("compileBudget", po::value<double>(&globals::compileBudget)->default_value(250.0), "ms of region compilation per wall clock second, most profitable regions first (0 = compile every region when ready)")
+   ("codeCacheKB", po::value<uint64_t>(&globals::codeCacheKB)->default_value(1UL<<16), "KB of compiled region code to keep, coldest regions are evicted past it (0 = no limit)")
+   ("irPipeline", po::value<std::string>(&globals::irPipeline)->default_value("bt"), "ir passes run on each region module : none, light, bt, O1, O2, O3 or a new pass manager pipeline string")
+   ("hostCPU", po::value<std::string>(&globals::hostCPU), "cpu regions are compiled for (default : the host cpu)")
+   ("hostFeatures", po::value<std::string>(&globals::hostFeatures), "comma separated +feature/-feature list regions are compiled with (default : the host features)")
+   ("hle", po::value<bool>(&globals::hle)->default_value(false), "run memcpy, memmove, memset, strlen and strcmp natively when called with jal")
+   ("hleCallCost", po::value<uint64_t>(&globals::hleCallCost)->default_value(10), "insns counted per emulated libc call")
+   ("hleByteCost", po::value<double>(&globals::hleByteCost)->default_value(1.0), "insns counted per byte touched by an emulated libc call")
+   ("chainRegions", po::value<bool>(&globals::chainRegions)->default_value(false), "pass hot guest registers in host registers and jump straight from region exits into compiled regions (with --memGuard 1 hot registers are still stored at every exit, guard page replay reads them)")
+   ("releaseIR", po::value<bool>(&globals::releaseIR)->default_value(true), "free region cfg, phis, insns and llvm ir once machine code is emitted")
    ("file,f", po::value<std::string>(&filename), "mips binary")
    ("hash,h", po::value<bool>(&hash)->default_value(false), "hash memory at end of execution")
    ("ipo,i", po::value<bool>(&globals::ipo)->default_value(true), "allow jr,jal,jalr in regions")
@@ -151,15 +221,29 @@ int main(int argc, char *argv[]) {
    ("verbose,v", po::value<bool>(&globals::verbose)->default_value(false), "print debug information")
    ("fp_exception", po::value<bool>(&fp_exception)->default_value(false), "fp exception")
    ("aug", po::value<uint32_t>(&augidx)->default_value(1), "how much cfg augmentation")
+   ("fuseCFGs", po::value<bool>(&globals::fuseCFGs)->default_value(false), "merge a new region with a compiled region that shares at least half of its blocks")
+   ("growThresh", po::value<uint64_t>(&globals::growThresh)->default_value(0), "region exits to one block before the region is rebuilt to cover it (0 disables)")
+   ("osr", po::value<uint32_t>(&osridx)->default_value(1), "side entries into regions : 0 none, 1 blocks outside loops and outermost loop headers, 2 every block")
    ("countInsns", po::value<bool>(&globals::countInsns)->default_value(true), "CFG code generation emits insns counts")
+   ("deferIcnt", po::value<bool>(&globals::deferIcnt)->default_value(true), "CFG code generation only updates insns counts on region edges not in a spanning tree")
    ("simPoints", po::value<bool>(&globals::simPoints)->default_value(false), "log for sim points")
    ("simPointsSlice", po::value<uint64_t>(&globals::simPointsSlice)->default_value(1UL<<24), "sim points slice")
    ("simPointsFname", po::value<std::string>(&simPointsFname), "sim points output file name")
+   ("loadRegions", po::value<std::string>(&regionsIn), "compile the regions in this profile before running")
+   ("saveRegions", po::value<std::string>(&regionsOut), "write the regions compiled by this run to a profile")
+   ("aot", po::value<std::string>(&aotOut), "translate every function found in the binary ahead of time into this host shared object and exit")
+   ("loadAot", po::value<std::string>(&aotIn), "run the regions of a shared object --aot wrote for this binary, host and code generation flags")
    ("max_icnt", po::value<uint64_t>(&max_icnt)->default_value(~0UL), "max icnt")
    ("splitCFGBBs",po::value<bool>(&globals::splitCFGBBs)->default_value(false), "split CFG basicblocks")
    ("blobName", po::value<std::string>(&globals::blobName)->default_value("blob.bin"), "binary blob name")
    ("icountMIPS", po::value<uint64_t>(&globals::icountMIPS)->default_value(500), "millions of of instructions per second for time calculation")
    ("dumpIR",po::value<bool>(&globals::dumpIR)->default_value(false), "dump IR")
+   ("loopOpt",po::value<bool>(&globals::loopOpt)->default_value(true), "run llvm loop optimizations on regions with natural loops")
+   ("memForward",po::value<bool>(&globals::memForward)->default_value(true), "forward sp/gp relative guest stores to loads and drop dead stores in regions")
+   ("promoteStack",po::value<bool>(&globals::promoteStack)->default_value(false), "keep sp relative stack slots in host registers within regions")
+   ("branchWeights",po::value<bool>(&globals::branchWeights)->default_value(true), "attach profiled branch weights to region branches and move exit stubs out of line")
+   ("memGuard",po::value<bool>(&globals::memGuard)->default_value(true), "map guard pages around guest memory and trap wild guest accesses")
+   ("smc",po::value<bool>(&globals::smc)->default_value(true), "write protect translated code and invalidate it when the guest writes to it")
    ("dumpCFG",po::value<bool>(&globals::dumpCFG)->default_value(false), "dump CFG");
   try {
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -175,10 +259,14 @@ int main(int argc, char *argv[]) {
   }
   
   globals::regionOptLevel = optLevels[optidx&3];
+  regionCFG::initPasses();
   globals::cfgAug = augLevels[augidx&3];
+  globals::osrEntries = osrLevels[osridx&3];
   
   if(globals::simPoints) {
     globals::countInsns = true;
+    /* log_bb needs exact counts at every block */
+    globals::deferIcnt = false;
   }
   if(simPointsFname.empty()) {
     simPointsFname = filename + "_" + std::to_string(rand()) + ".sp";
@@ -196,17 +284,17 @@ int main(int argc, char *argv[]) {
   initState(s);
 
 #ifdef __linux__
-  void* mempt = mmap(nullptr, 1UL<<32, PROT_READ | PROT_WRITE,
+  void* mempt = mmap(nullptr, (1UL<<32) + memGuardTail, PROT_READ | PROT_WRITE,
 #ifdef __amd64__
 		     (21 << MAP_HUGE_SHIFT) |
 #endif
 		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
 #else
-  void* mempt = mmap(nullptr, 1UL<<32, PROT_READ | PROT_WRITE,
+  void* mempt = mmap(nullptr, (1UL<<32) + memGuardTail, PROT_READ | PROT_WRITE,
 		     MAP_PRIVATE | MAP_ANONYMOUS , -1, 0);
 #endif
   assert(mempt != reinterpret_cast<void*>(-1));
-  assert(madvise(mempt, 1UL<<32, MADV_DONTNEED)==0);
+  assert(madvise(mempt, (1UL<<32) + memGuardTail, MADV_DONTNEED)==0);
   mem = reinterpret_cast<uint8_t*>(mempt);
   if(mem == nullptr) {
     std::cerr << globals::binaryName << ": couldn't allocate backing memory!\n";
@@ -218,15 +306,67 @@ int main(int argc, char *argv[]) {
   std::map<uint32_t, std::pair<std::string, uint32_t>> syms;
   
   load_elf(filename.c_str(), s);
+  initHLE();
+  llvm::sys::DynamicLibrary::AddSymbol("rv32_hle", reinterpret_cast<void*>(&rv32_hle));
 
   globals::regionFinder = new region(cl, hotThresh);
-  globals::cBB = new basicBlock(s->pc);
+  if(not(aotOut.empty())) {
+    aot::translate(filename, s, aotOut);
+    return 0;
+  }
+  if(not(aotIn.empty()) and globals::enableCFG) {
+    aot::load(aotIn, filename, s);
+  }
+  if(not(regionsIn.empty()) and globals::enableCFG) {
+    regionProfile::load(regionsIn, s);
+  }
+  globals::cBB = basicBlock::globalFindBlock(s->pc);
+  if(globals::cBB == nullptr) {
+    globals::cBB = new basicBlock(s->pc);
+  }
   initCapstone();
 
   performance_counters cnt0 = get_counters();
   estart = timestamp();
-  if(setjmp(jenv) > 0) {
-    std::cerr << globals::binaryName << ": returning from longjmp\n";
+  uint64_t tstart = rdtsc();
+  if(globals::memGuard or globals::smc) {
+    initMemProtect(s, &jenv, globals::lowestLoadAddr);
+  }
+  if(sigsetjmp(jenv, 1) > 0) {
+    regionCFG *r = dynamic_cast<regionCFG*>(globals::currUnit);
+    if(r) {
+      /* faulted in a region : guest registers, pc and icnt are
+       * only written back at region exits so the state is still
+       * at region entry. replay the region in the interpreter
+       * until the access faults again, that report is precise.
+       * stores the region made before the fault are made again.
+       * the replay stops at max_icnt or where it leaves r, a
+       * fault in a region chained to is never reached from r's
+       * entry state. both report the pc the line table of the
+       * faulting code gives, it is the insn or one next to it */
+      uint64_t host = lastFaultHostPC();
+      regionCFG *fr = regionCFG::findByHostPC(host);
+      uint32_t fpc = 0, va = s->bad_vaddr;
+      bool mapped = fr and fr->guestPC(host, fpc);
+      globals::currUnit = nullptr;
+      s->bad_addr = 0;
+      while((fr == nullptr or fr == r) and s->brk==0 and
+	    s->icnt < max_icnt and r->covers(s->pc)) {
+	interpret(s);
+      }
+      if(s->brk==0) {
+	if(mapped) {
+	  s->pc = fpc;
+	}
+	s->bad_vaddr = va;
+	reportMemFault(s);
+	s->brk = 1;
+      }
+    }
+    else {
+      reportMemFault(s);
+      s->brk = 1;
+    }
   }
 
   
@@ -237,6 +377,9 @@ int main(int argc, char *argv[]) {
   }
   else {
     while(s->brk==0) {
+      if(codeWritePending) {
+	invalidateWrittenCode(s);
+      }
       if(not(globals::cBB->executeJIT(s)))
 	interpretAndBuildCFG(s);
     }
@@ -245,6 +388,7 @@ int main(int argc, char *argv[]) {
   cnt0 -= get_counters();
   
   double runtime = (estop-estart);
+  regionCFG::ticksPerSec = (rdtsc() - tstart) / runtime;
   struct rusage usage;
   uint64_t dupIns = 0;
   getrusage(RUSAGE_SELF,&usage);  
@@ -254,41 +398,7 @@ int main(int argc, char *argv[]) {
     }
   }
   
-  std::cerr << KGRN << globals::binaryName << " statistics\n"
-	    << "\t"
-	    << runtime << " sec, "
-	    << cnt0.computeIPC() << " host IPC, "
-	    << s->icnt << " rv32 ins executed"
-	    << " (" << regionCFG::icnt << " cfg), "
-	    << std::round(s->icnt / (runtime*1e6))
-	    << " megains/sec" << "\n"
-	    << "\t" << 100.0*(static_cast<double>(regionCFG::icnt)/s->icnt)
-	    << "% of instructions executed in CFG JIT\n"
-	    << "\t" << 100.0*(static_cast<double>(s->icnt - regionCFG::icnt)/s->icnt)
-	    << "% of instructions executed in the interpreter\n"
-	    << "\t"
-	    << "regionCFGs size="
-	    << regionCFG::regionCFGs.size()
-	    << ", compile called = "
-	    << globals::nCfgCompiles
-	    << " times\n"
-	    << "\t"
-	    << basicBlock::numBBs() << " basic blocks, "
-	    << basicBlock::numStaticInsns() << " static instructions, "
-	    << dupIns << " duplicated instructions\n"
-	    << "\tcode invoked = "
-	    << regionCFG::iters
-	    << " times, "
-	    << (static_cast<double>(regionCFG::icnt)/ regionCFG::iters)
-	    << " insns per invocation on average\n"
-	    << "\t" << usage
-	    << KNRM << "\n";
-  
-  if(globals::simPoints) {
-    save_simpoints_data(simPointsFname);
-  }
-
-  
+  /* reports symbolize their pcs, the time goes in the stats */
   if(report) {
     debugSymDB::init(filename.c_str());
     std::vector<execUnit*> eUnitVec;
@@ -332,6 +442,82 @@ int main(int argc, char *argv[]) {
       freport.close();
     }    
   }
+
+  std::cerr << KGRN << globals::binaryName << " statistics\n"
+	    << "\t"
+	    << runtime << " sec, "
+	    << cnt0.computeIPC() << " host IPC, "
+	    << s->icnt << " rv32 ins executed"
+	    << " (" << regionCFG::icnt << " cfg), "
+	    << std::round(s->icnt / (runtime*1e6))
+	    << " megains/sec" << "\n"
+	    << "\t" << 100.0*(static_cast<double>(regionCFG::icnt)/s->icnt)
+	    << "% of instructions executed in CFG JIT\n"
+	    << "\t" << 100.0*(static_cast<double>(s->icnt - regionCFG::icnt)/s->icnt)
+	    << "% of instructions executed in the interpreter\n"
+	    << "\t"
+	    << "regionCFGs size="
+	    << regionCFG::regionCFGs.size()
+	    << ", compile called = "
+	    << globals::nCfgCompiles
+	    << " times\n"
+	    << "\t"
+	    << basicBlock::numBBs() << " basic blocks, "
+	    << basicBlock::numStaticInsns() << " static instructions, "
+	    << dupIns << " duplicated instructions\n"
+	    << "\t" << (regionCFG::domTime * 1e3) << " ms computing dominators and frontiers\n"
+	    << "\t" << (regionCFG::buildTime * 1e3) << " ms compiling regions, "
+	    << (regionCFG::regionsBuilt ? (regionCFG::buildTime * 1e3) / regionCFG::regionsBuilt : 0.0)
+	    << " ms per region, "
+	    << (regionCFG::arenaBytes >> 10) << " KB of region arena, "
+	    << (regionCFG::optTime * 1e3) << " ms in the ir pipeline\n"
+	    << "\t" << regionSched::deferred << " regions queued by the compile budget, "
+	    << regionSched::numPending() << " never compiled, "
+	    << regionSched::dropped << " dropped as unprofitable\n"
+	    << "\t" << globals::regionFinder->getTooLongAborts() << " region traces too long to record, "
+	    << regionProfile::regionsLoaded << " regions loaded from a profile, "
+	    << regionProfile::regionsRejected << " rejected, "
+	    << aot::regionsLoaded << " loaded from a shared object, "
+	    << aot::regionsNotLoaded << " rejected\n"
+	    << "\t" << (regionCFG::codeCacheBytes >> 10) << " KB of region code cached, "
+	    << regionCFG::evictions << " regions evicted, "
+	    << regionCFG::recompiles << " recompiled after eviction\n"
+	    << "\t" << regionCFG::regionsGrown << " regions grown into hot exits, "
+	    << globals::nFuses << " of " << globals::nAttemptedFuses << " region fusions done\n"
+	    << "\t" << regionCFG::osrEntriesEmitted << " side entries compiled, "
+	    << regionCFG::osrRuns << " region runs through a side entry\n"
+	    << "\tcode invoked = "
+	    << regionCFG::iters
+	    << " times, "
+	    << (static_cast<double>(regionCFG::icnt)/ regionCFG::iters)
+	    << " insns per invocation on average\n"
+	    << "\t" << regionCFG::exitStores << " register stores at region exits, "
+	    << regionCFG::exitStoresElided << " elided\n"
+	    << "\t" << regionCFG::memLoadsForwarded << " guest loads forwarded from stores, "
+	    << regionCFG::memLoadsReused << " reused, "
+	    << regionCFG::memStoresElided << " guest stores elided\n"
+	    << "\t" << regionCFG::stackSlotsPromoted << " stack slots promoted, "
+	    << regionCFG::stackOpsPromoted << " guest memory ops promoted, "
+	    << regionCFG::stackOpsMaterialized << " slot loads/stores materialized\n"
+	    << "\t" << globals::nInvalidatedPages << " code pages written, "
+	    << globals::nInvalidatedBlocks << " basic blocks invalidated\n"
+	    << "\t" << regionCFG::hleCallsEmitted << " emulated libc calls compiled into regions\n"
+	    << "\t" << regionCFG::chainExitsEmitted << " region exits compiled to chain into the next region\n";
+  if(debugSymDB::lookups) {
+    std::cerr << "\t" << (debugSymDB::symbolizeTime * 1e3) << " ms symbolizing "
+	      << debugSymDB::lookups << " report pcs\n";
+  }
+  hleReport(std::cerr);
+  std::cerr << "\t" << usage
+	    << KNRM << "\n";
+  
+  if(globals::simPoints) {
+    save_simpoints_data(simPointsFname);
+  }
+  if(not(regionsOut.empty())) {
+    regionProfile::save(regionsOut);
+  }
+
   
   if(globals::dumpCFG) {
     basicBlock::dumpCFG();
@@ -339,6 +525,7 @@ int main(int argc, char *argv[]) {
   
   basicBlock::dropAllBBs();
   delete globals::regionFinder;
+  releaseMemProtect(s);
   
   if(hash) {
     std::cerr << "crc32=" << std::hex
@@ -347,7 +534,7 @@ int main(int argc, char *argv[]) {
   }
       
 
-  munmap(mempt, 1UL<<32);
+  munmap(mempt, (1UL<<32) + memGuardTail);
 
   if(sysArgv) {
     for(int i = 0; i < sysArgc; i++) {
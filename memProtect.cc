@@ -0,0 +1,224 @@
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "memProtect.hh"
+#include "state.hh"
+#include "helper.hh"
+#include "disassemble.hh"
+#include "basicBlock.hh"
+#define ELIDE_LLVM
+#include "globals.hh"
+
+static const uint32_t pgSize = 4096;
+static const uint32_t nPages = 1U<<20;
+static state_t *guardState = nullptr;
+static sigjmp_buf *guardEnv = nullptr;
+static uint8_t *guestMem = nullptr;
+static uint32_t lowGuardBytes = 0;
+static struct sigaction oldAction;
+static uintptr_t faultHostPC = 0;
+/* plain words, both are touched from the signal handler */
+static uint64_t codePages[nPages/64];
+static uint64_t writtenPages[nPages/64];
+
+volatile sig_atomic_t codeWritePending = 0;
+
+static inline bool testPage(const uint64_t *bits, uint32_t pg) {
+  return (bits[pg>>6] >> (pg&63)) & 1;
+}
+
+static inline void setPage(uint64_t *bits, uint32_t pg) {
+  bits[pg>>6] |= (1UL << (pg&63));
+}
+
+static inline void clearPage(uint64_t *bits, uint32_t pg) {
+  bits[pg>>6] &= ~(1UL << (pg&63));
+}
+
+static uintptr_t hostPCOf(void *uc) {
+  ucontext_t *ctx = reinterpret_cast<ucontext_t*>(uc);
+#if defined(__APPLE__) and defined(__x86_64__)
+  return ctx->uc_mcontext->__ss.__rip;
+#elif defined(__APPLE__) and defined(__aarch64__)
+  return ctx->uc_mcontext->__ss.__pc;
+#elif defined(__linux__) and defined(__x86_64__)
+  return ctx->uc_mcontext.gregs[REG_RIP];
+#elif defined(__linux__) and defined(__aarch64__)
+  return ctx->uc_mcontext.pc;
+#elif defined(__FreeBSD__) and defined(__x86_64__)
+  return ctx->uc_mcontext.mc_rip;
+#else
+  return 0;
+#endif
+}
+
+static void memFaultHandler(int sig, siginfo_t *si, void *uc) {
+  uint8_t *fa = reinterpret_cast<uint8_t*>(si->si_addr);
+  if(guardState == nullptr or fa < guardState->mem or
+     fa >= (guardState->mem + (1UL<<32) + memGuardTail)) {
+    /* not a guest access : restore the old handler and
+     * let the faulting host instruction fault again */
+    sigaction(SIGSEGV, &oldAction, nullptr);
+    return;
+  }
+  uint64_t va = fa - guardState->mem;
+  if(va < (1UL<<32) and testPage(codePages, va / pgSize)) {
+    /* code pages are only ever read protected, so this is a
+     * write. let it through and invalidate at the next dispatch */
+    uint32_t pg = va / pgSize;
+    clearPage(codePages, pg);
+    setPage(writtenPages, pg);
+    mprotect(guardState->mem + pg*pgSize, pgSize, PROT_READ|PROT_WRITE);
+    codeWritePending = 1;
+    return;
+  }
+  guardState->bad_addr = 1;
+  guardState->bad_vaddr = static_cast<uint32_t>(va);
+  faultHostPC = hostPCOf(uc);
+  siglongjmp(*guardEnv, 1);
+}
+
+void initMemProtect(state_t *s, sigjmp_buf *env, uint32_t lowestLoadAddr) {
+  struct sigaction sa;
+  guardState = s;
+  guardEnv = env;
+  guestMem = s->mem;
+  if(globals::memGuard) {
+    /* never cover a loaded segment */
+    lowGuardBytes = std::min(memGuardLow, lowestLoadAddr) & ~(pgSize-1);
+    if(lowGuardBytes) {
+      int rc = mprotect(s->mem, lowGuardBytes, PROT_NONE);
+      assert(rc == 0);
+    }
+    int rc = mprotect(s->mem + (1UL<<32), memGuardTail, PROT_NONE);
+    assert(rc == 0);
+  }
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = memFaultHandler;
+  sa.sa_flags = SA_SIGINFO;
+  sigemptyset(&sa.sa_mask);
+  int rc = sigaction(SIGSEGV, &sa, &oldAction);
+  assert(rc == 0);
+}
+
+void releaseMemProtect(state_t *s) {
+  if(guardState == nullptr) {
+    return;
+  }
+  sigaction(SIGSEGV, &oldAction, nullptr);
+  if(lowGuardBytes) {
+    mprotect(s->mem, lowGuardBytes, PROT_READ|PROT_WRITE);
+  }
+  if(globals::memGuard) {
+    mprotect(s->mem + (1UL<<32), memGuardTail, PROT_READ|PROT_WRITE);
+  }
+  guardState = nullptr;
+  guardEnv = nullptr;
+  lowGuardBytes = 0;
+}
+
+uintptr_t lastFaultHostPC() {
+  return faultHostPC;
+}
+
+bool isGuardPage(uint32_t va) {
+  return va < lowGuardBytes;
+}
+
+void protectCode(uint8_t *mem, uint32_t va, uint32_t len) {
+  guestMem = mem;
+  int rc = mprotect(mem + va, len, PROT_READ);
+  if(rc != 0) {
+    printf("mprotect rc = %d, error(%d) = %s\n", rc, 
+	   errno, strerror(errno));
+    return;
+  }
+  if(globals::smc) {
+    for(uint32_t pg = va / pgSize; pg < (va + len) / pgSize; pg++) {
+      setPage(codePages, pg);
+    }
+  }
+}
+
+void trackCodePage(uint32_t va) {
+  uint32_t pg = va / pgSize;
+  if(not(globals::smc) or testPage(codePages, pg)) {
+    return;
+  }
+  int rc = mprotect(guestMem + pg*pgSize, pgSize, PROT_READ);
+  assert(rc == 0);
+  setPage(codePages, pg);
+}
+
+void markCodeWritten(uint32_t va, uint32_t len) {
+  /* writes made by the host kernel (read(2) into guest memory)
+   * would fail with EFAULT instead of faulting */
+  if(len == 0) {
+    return;
+  }
+  uint64_t last = (static_cast<uint64_t>(va) + len - 1) / pgSize;
+  for(uint64_t pg = va / pgSize; pg <= last and pg < nPages; pg++) {
+    if(testPage(codePages, pg)) {
+      clearPage(codePages, pg);
+      setPage(writtenPages, pg);
+      mprotect(guestMem + pg*pgSize, pgSize, PROT_READ|PROT_WRITE);
+      codeWritePending = 1;
+    }
+  }
+}
+
+void invalidateWrittenCode(state_t *s) {
+  codeWritePending = 0;
+  for(uint32_t w = 0; w < (nPages/64); w++) {
+    uint64_t b = writtenPages[w];
+    writtenPages[w] = 0;
+    while(b) {
+      uint32_t pg = w*64 + __builtin_ctzl(b);
+      b &= (b-1);
+      globals::nInvalidatedBlocks +=
+	basicBlock::invalidateCode(pg*pgSize, (pg+1)*pgSize, s->pc);
+      globals::nInvalidatedPages++;
+    }
+  }
+}
+
+void reportMemFault(state_t *s) {
+  /* s->pc is precise here, the interpreter only advances
+   * the pc after the access completes */
+  if(isGuardPage(s->pc)) {
+    s->epc = s->pc;
+    std::cerr << KRED << globals::binaryName
+	      << ": instruction access fault at pc " << std::hex << s->pc
+	      << std::dec << ", icnt " << s->icnt
+	      << KNRM << "\n";
+    return;
+  }
+  uint32_t inst = *reinterpret_cast<uint32_t*>(s->mem + s->pc);
+  const char *kind = "access fault";
+  switch(inst & 127)
+    {
+    case 0x3:
+      kind = "load access fault";
+      break;
+    case 0x23:
+      kind = "store access fault";
+      break;
+    default:
+      break;
+    }
+  s->epc = s->pc;
+  std::cerr << KRED << globals::binaryName << ": " << kind
+	    << " at pc " << std::hex << s->pc
+	    << " (" << getAsmString(inst, s->pc) << ")"
+	    << ", address " << s->bad_vaddr << std::dec
+	    << ", icnt " << s->icnt
+	    << KNRM << "\n";
+}
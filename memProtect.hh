@@ -0,0 +1,42 @@
+#ifndef __MEMPROTECT_HH__
+#define __MEMPROTECT_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <setjmp.h>
+#include <signal.h>
+
+struct state_t;
+
+/* guest memory protection : guest loads and stores are never
+ * checked inline, instead low guard pages and a guard region past
+ * the top of the 4 GiB window are mapped PROT_NONE and the SIGSEGV
+ * handler turns host faults in guest memory into guest faults.
+ *
+ * pages holding translated code are write protected, a write
+ * fault on one makes it writable again and queues it for
+ * invalidation at the next dispatch. the page is protected
+ * again once code on it is decoded again. */
+
+/* bytes mapped past the 4 GiB guest window, catches accesses that
+ * straddle the top of the address space */
+static const size_t memGuardTail = 1UL<<16;
+/* upper bound on the low (null pointer) guard region */
+static const uint32_t memGuardLow = 1U<<16;
+
+/* set from the SIGSEGV handler when a code page was written */
+extern volatile sig_atomic_t codeWritePending;
+
+void initMemProtect(state_t *s, sigjmp_buf *env, uint32_t lowestLoadAddr);
+void releaseMemProtect(state_t *s);
+bool isGuardPage(uint32_t va);
+/* host pc of the last guest memory fault, 0 if unknown */
+uintptr_t lastFaultHostPC();
+void reportMemFault(state_t *s);
+
+void protectCode(uint8_t *mem, uint32_t va, uint32_t len);
+void trackCodePage(uint32_t va);
+void markCodeWritten(uint32_t va, uint32_t len);
+void invalidateWrittenCode(state_t *s);
+
+#endif
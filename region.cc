@@ -1,4 +1,5 @@
 #include <cassert>
+#include <algorithm>
 #include "region.hh"
 #include "basicBlock.hh"
 #include "helper.hh"
@@ -14,69 +15,107 @@ void region::updateRegionHeads(basicBlock *bb, basicBlock *lbb) {
   uint32_t lbb_ea = lbb->getEntryAddr();
   
   /* forward branch...*/
-  if(bb_ea > lbb_ea /*|| bb->hasRegion*/ || enHistCollection)
+  if(bb_ea > lbb_ea /*|| bb->hasRegion*/)
     return;
-  
-  uint32_t idx = computeIndex(bb_ea);
-  if(regionHeads[idx] == bb) {
-    regionCounts[idx] += 1;
-    if(regionCounts[idx] >= hotThresh) {
-      enHistCollection = true;
-      currRegionHead = bb;
-      histBufPos = 0;
-      regionHeads[idx] = nullptr;
+
+  /* counts live in the block, loops never fight over a slot */
+  if(bb->headCount < hotThresh) {
+    bb->headCount++;
+  }
+  if(bb->headCount < hotThresh or recordings.size() == maxRecordings) {
+    return;
+  }
+  for(const recording &r : recordings) {
+    if(r.head == bb) {
+      return;
     }
   }
-  else {
-    regionHeads[idx] = bb;
-    regionCounts[idx] = 1;
+  if(bb->traceLimit == 0) {
+    bb->traceLimit = std::min(initialTraceLimit, numEntries-1);
   }
+  bb->headCount = 0;
+  recordings.emplace_back();
+  recording &r = recordings.back();
+  r.head = bb;
+  r.limit = bb->traceLimit;
+  r.trace.reserve(r.limit);
+}
+
+void region::abortRecording(size_t i) {
+  recordings.erase(recordings.begin() + i);
 }
 
 void region::disableRegionCollection() {
-  if(enHistCollection){
-    enHistCollection = false;
-    if(currRegionHead) {
-      uint32_t idx = computeIndex(currRegionHead->getEntryAddr());
-      regionCounts[idx] = 0;
-      regionHeads[idx] = nullptr;
-    }
-    currRegionHead = nullptr;
-    histBufPos = 0;
-  }
+  recordings.clear();
 }
 
 void region::getRegion(std::vector<basicBlock*> &region) {
-  region.clear();
-  uint32_t idx = computeIndex(currRegionHead->getEntryAddr());
-  for(size_t i = 0; i < histBufPos; i++)
-    region.push_back(blockCache.at(i));
-  histBufPos = 0;
-  currRegionHead = nullptr;
-  regionCounts[idx] = 0;
-  regionHeads[idx] = nullptr;
+  region.swap(finished);
+  finished.clear();
 }
 
 bool region::update(basicBlock *bb) {
   if(globals::profile)
     return false;
-    
-  if(enHistCollection) {
-    if((bb == currRegionHead) && (histBufPos != 0)) {
-      enHistCollection = false;
-      return true;
+
+  bool done = false;
+  for(size_t i = 0; i < recordings.size(); ) {
+    recording &r = recordings[i];
+    if((bb == r.head) and not(r.trace.empty())) {
+      /* one head per recording, at most one finishes here */
+      finished.swap(r.trace);
+      abortRecording(i);
+      done = true;
     }
-    else if(histBufPos == (numEntries-1)) {
+    else if(r.trace.size() == r.limit) {
       tooLongAborts++;
-      enHistCollection = false;
-      return false;
+      /* give this head more room next time */
+      r.head->traceLimit = std::min(2*r.limit, numEntries-1);
+      abortRecording(i);
     }
     else {
-      blockCache[histBufPos++] = bb;
-      return false;
+      r.trace.push_back(bb);
+      i++;
     }
   }
-  return false;
+  return done;
 }
 
-
+void region::skipRegion(basicBlock *entry, basicBlock *exit, basicBlock *next,
+			const std::set<basicBlock*> &blocks) {
+  if(recordings.empty()) {
+    return;
+  }
+  /* only what the region reaches from where it was entered, blocks
+   * before an osr entry would hang off the trace unconnected */
+  std::vector<basicBlock*> reached = {entry};
+  std::set<basicBlock*> seen = {entry};
+  for(size_t i = 0; i < reached.size(); i++) {
+    for(basicBlock *nbb : reached[i]->getSuccs()) {
+      if(blocks.count(nbb) and seen.insert(nbb).second) {
+	reached.push_back(nbb);
+      }
+    }
+  }
+  /* a chained exit left from a region the traces know nothing of */
+  if(seen.find(exit) == seen.end()) {
+    recordings.clear();
+    return;
+  }
+  /* the interpreter never took the exit edge, without it the
+   * blocks past the exit are unreachable from the trace head */
+  exit->addSuccessor(next);
+  for(size_t i = 0; i < recordings.size(); ) {
+    recording &r = recordings[i];
+    if((r.trace.size() + reached.size()) > r.limit) {
+      tooLongAborts++;
+      r.head->traceLimit = std::min(std::max(2*r.limit, r.trace.size() + reached.size()),
+				    numEntries-1);
+      abortRecording(i);
+    }
+    else {
+      r.trace.insert(r.trace.end(), reached.begin(), reached.end());
+      i++;
+    }
+  }
+}
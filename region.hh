@@ -5,48 +5,52 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <set>
 #include <vector>
-#include <array>
 
 #include "basicBlock.hh"
 
 class region {
  private:
-  const static size_t nRegionHeads = 1024;
+  /* traces recorded at the same time */
+  const static size_t maxRecordings = 4;
+  /* first length limit for a head, doubled each time one of its
+   * traces runs out of room up to numEntries */
+  const static size_t initialTraceLimit = 32;
+  struct recording {
+    basicBlock *head = nullptr;
+    size_t limit = 0;
+    std::vector<basicBlock*> trace;
+  };
   /* constructor list initialized */
   size_t numEntries, hotThresh;
   /* other stuff in constructor */
-  std::vector<basicBlock*> blockCache;
-  std::array<basicBlock*, nRegionHeads> regionHeads;
-  std::array<size_t, nRegionHeads> regionCounts;
-  bool enHistCollection = false;
-  size_t histBufPos = 0, tooLongAborts = 0;
-  basicBlock *currRegionHead = nullptr;
-  uint32_t computeIndex(uint32_t pc) const {
-    return (pc >> 2) & (nRegionHeads-1);
-  }
+  std::vector<recording> recordings;
+  /* trace finished by the last update(), handed out by getRegion */
+  std::vector<basicBlock*> finished;
+  size_t tooLongAborts = 0;
+  void abortRecording(size_t i);
 public:
   region(size_t lgNumEntries, size_t hotThresh) :
     numEntries(1UL<<lgNumEntries), hotThresh(hotThresh) {
-    blockCache.resize(numEntries, nullptr);
-    regionHeads.fill(nullptr);
-    regionCounts.fill(0);
+    recordings.reserve(maxRecordings);
   }  
   bool collectionEnabled() const {
-    return enHistCollection;
+    return not(recordings.empty());
   }
-  uint64_t getRegionLen() const {
-    return histBufPos;
+  size_t getTooLongAborts() const {
+    return tooLongAborts;
   }
   void clear() {
-    std::fill(blockCache.begin(), blockCache.end(), nullptr);
-    regionHeads.fill(nullptr);
-    regionCounts.fill(0);
-    currRegionHead = nullptr;
-    histBufPos = 0;
-    enHistCollection = false;
+    recordings.clear();
+    finished.clear();
   }
   bool update(basicBlock *bb);
+  /* compiled code entered at entry and left from exit to next ran
+   * blocks the traces didn't see, append the region's blocks in
+   * their place */
+  void skipRegion(basicBlock *entry, basicBlock *exit, basicBlock *next,
+		  const std::set<basicBlock*> &blocks);
   void getRegion(std::vector<basicBlock*> &region);
   void disableRegionCollection();
   void updateRegionHeads(basicBlock *bb, basicBlock *lbb);
@@ -0,0 +1,74 @@
+#include <cstdlib>
+#include <new>
+
+#include "regionArena.hh"
+
+regionArena *regionArena::current = nullptr;
+
+/* every object is preceded by a header recording where it came
+ * from, keeps everything 16 byte aligned */
+static const size_t hdrSize = 16;
+enum : uintptr_t {fromArena = 0x61726e61, fromHeap = 0x68656170};
+
+regionArena::~regionArena() {
+  clear();
+}
+
+void regionArena::clear() {
+  for(uint8_t *c : chunks) {
+    std::free(c);
+  }
+  chunks.clear();
+  cur = end = nullptr;
+  bytes = 0;
+}
+
+void *regionArena::bump(size_t sz) {
+  sz = (sz + 15) & ~static_cast<size_t>(15);
+  if(sz > (chunkSize/4)) {
+    /* big objects get their own chunk, the current one stays live */
+    uint8_t *c = static_cast<uint8_t*>(std::malloc(sz));
+    if(c == nullptr) {
+      throw std::bad_alloc();
+    }
+    chunks.push_back(c);
+    bytes += sz;
+    return c;
+  }
+  if((cur == nullptr) or (static_cast<size_t>(end - cur) < sz)) {
+    cur = static_cast<uint8_t*>(std::malloc(chunkSize));
+    if(cur == nullptr) {
+      throw std::bad_alloc();
+    }
+    end = cur + chunkSize;
+    chunks.push_back(cur);
+  }
+  void *p = cur;
+  cur += sz;
+  bytes += sz;
+  return p;
+}
+
+void *regionArena::allocate(size_t sz) {
+  uint8_t *p = nullptr;
+  uintptr_t tag = fromArena;
+  if(current) {
+    p = static_cast<uint8_t*>(current->bump(sz + hdrSize));
+  }
+  else {
+    p = static_cast<uint8_t*>(::operator new(sz + hdrSize));
+    tag = fromHeap;
+  }
+  *reinterpret_cast<uintptr_t*>(p) = tag;
+  return p + hdrSize;
+}
+
+void regionArena::release(void *p) {
+  if(p == nullptr) {
+    return;
+  }
+  uint8_t *h = static_cast<uint8_t*>(p) - hdrSize;
+  if(*reinterpret_cast<uintptr_t*>(h) == fromHeap) {
+    ::operator delete(h);
+  }
+}
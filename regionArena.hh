@@ -0,0 +1,47 @@
+#ifndef __REGIONARENA_HH__
+#define __REGIONARENA_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* per region bump allocator. cfgBasicBlock, phi and Insn objects
+ * built while a scope is active come out of the region arena, the
+ * storage is released in one shot when the owning regionCFG goes
+ * away. delete still runs destructors but only returns memory for
+ * objects that were allocated with no arena active */
+class regionArena {
+private:
+  static const size_t chunkSize = 1UL<<16;
+  static regionArena *current;
+  std::vector<uint8_t*> chunks;
+  uint8_t *cur = nullptr;
+  uint8_t *end = nullptr;
+  size_t bytes = 0;
+  void *bump(size_t sz);
+public:
+  regionArena() {}
+  ~regionArena();
+  /* every object in the arena must be dead */
+  void clear();
+  regionArena(const regionArena &) = delete;
+  regionArena &operator=(const regionArena &) = delete;
+  size_t allocatedBytes() const {
+    return bytes;
+  }
+  static void *allocate(size_t sz);
+  static void release(void *p);
+  class scope {
+  private:
+    regionArena *prev;
+  public:
+    scope(regionArena *a) : prev(current) {
+      current = a;
+    }
+    ~scope() {
+      current = prev;
+    }
+  };
+};
+
+#endif
@@ -1,10 +1,13 @@
 #include <queue>
+#include <deque>
 #include <algorithm>
 #include <ostream>
 #include <limits>
 #include <fstream>
-#include <boost/dynamic_bitset.hpp>
 #include <fcntl.h>
+#include <unistd.h>
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/Linker/Linker.h>
 
 #include "regionCFG.hh"
 #include "helper.hh"
@@ -13,122 +16,12 @@
 #include "globals.hh"
 #include "saveState.hh"
 #include "interpret.hh"
+#include "memProtect.hh"
+#include "dominators.hh"
+#include "hle.hh"
 
 static regionCFG *currCFG = nullptr;
 
-/* Implementation from Muchnick and Lengauer-Tarjan TOPLAS 
- * paper. Vague understanding from Appel. */
-class LengauerTarjanDominators {
-private:
-  std::vector<cfgBasicBlock*> &blocks;
-  cfgBasicBlock *root = nullptr;
-  ssize_t dfsCounter = 1;
-  /* Parent in the DFS tree */
-  std::map<cfgBasicBlock*, cfgBasicBlock*> Parent;
-  /* Ancestor chain in DFS tree */
-  std::map<cfgBasicBlock*, cfgBasicBlock*> Ancestor;
-  std::map<cfgBasicBlock*, cfgBasicBlock*> Label;
-  std::map<cfgBasicBlock*, std::set<cfgBasicBlock*>> Buckets;
-  std::map<ssize_t, cfgBasicBlock*> Ndfs;
-  std::map<cfgBasicBlock*, ssize_t> Sdno;
-  
-  void DFS(cfgBasicBlock *bb) {
-    Sdno.at(bb) = dfsCounter;
-    Ndfs[dfsCounter] = bb;
-    Label[bb] = bb;
-    Ancestor[bb] = nullptr;
-    dfsCounter++;
-    for(cfgBasicBlock *nbb : bb->getSuccs()) {
-      if(Sdno.at(nbb) == 0) {
-	Parent[nbb] = bb;
-	DFS(nbb);
-      }
-    }
-  }
-  /* these methods are from Lengauer-Tarjan paper
-   * and implement O(n*lg(n)) scheme */
-  void Link(cfgBasicBlock *v, cfgBasicBlock *w) {
-    Ancestor.at(w) = v;
-  }
-  void Compress(cfgBasicBlock *bb) {
-    if(Ancestor.at(Ancestor.at(bb))) {
-      Compress(Ancestor.at(bb));
-      if(Sdno.at(Label.at(Ancestor.at(bb))) < Sdno.at(Label.at(bb))) {
-	Label.at(bb) = Label.at(Ancestor.at(bb));
-      }
-      Ancestor.at(bb) = Ancestor.at(Ancestor.at(bb));
-    }
-  }
-  cfgBasicBlock *Eval(cfgBasicBlock *bb) {
-    if(!Ancestor.at(bb)) {
-      return bb;
-    }
-    else {
-      Compress(bb);
-      return Label.at(bb);
-    }
-  }
-  
-public:
-  LengauerTarjanDominators(std::vector<cfgBasicBlock*> &blocks) : blocks(blocks) {}
-  void operator()() {
-    for(cfgBasicBlock *bb : blocks) {
-      if(bb->getPreds().empty()) {
-	assert(root==nullptr);
-	root = bb;
-      }
-      Sdno[bb] = 0;
-      Parent[bb] = nullptr;
-      bb->getIdom() = nullptr;
-    }
-    assert(root);
-    DFS(root);
-    
-    for(ssize_t i = (dfsCounter-1); i > 1; i--) {
-      cfgBasicBlock *w = Ndfs.at(i);
-      ssize_t &sdom_w = Sdno.at(w);
-      for(cfgBasicBlock *pbb : w->getPreds()) {
-	cfgBasicBlock *u = Eval(pbb);
-	ssize_t sdom_u = Sdno.at(u);
-	if(sdom_u < sdom_w) {
-	  sdom_w = sdom_u;
-	}
-      }
-      Buckets[Ndfs.at(sdom_w)].insert(w);
-      Link(Parent.at(w), w);
-      /* need to understand - why parent bucket? */
-      std::set<cfgBasicBlock*> &pBucket = Buckets[Parent.at(w)];
-      for(cfgBasicBlock *v : pBucket) {
-	/* find ancestor with lowest semidominator */
-	cfgBasicBlock *u = Eval(v);
-	if(Sdno.at(u) < Sdno.at(v)) {
-	  /* idom is the semidominator */
-	  v->getIdom() = u;
-	}
-	else {
-	  /* must defer */
-	  v->getIdom() = Parent.at(w);
-	}
-      }
-      pBucket.clear();
-    }
-    for(ssize_t i = 2; i < dfsCounter; i++) {
-      cfgBasicBlock *w = Ndfs.at(i);
-      if(w->getIdom() != Ndfs.at(Sdno.at(w))) {
-	w->getIdom() = w->getIdom()->getIdom();
-      }
-    }
-    for(cfgBasicBlock *bb : blocks) {
-      if(bb->getPreds().empty()) {
-	continue;
-      }
-      bb->getIdom()->addDTreeSucc(bb);
-    }
-  }
-  
-};
-
-
 template <typename T>
 class sortByIcnt {
 public:
@@ -137,30 +30,65 @@ public:
   }
 };
 
+/* scratch state shared by the aug_dfs searches of one buildCFG.
+ * blocks get dense ids on first touch, their successors are sorted
+ * by icnt once instead of once per search and seen is an epoch per
+ * id, so starting a search clears it for free. a deque keeps the
+ * successor vectors in place while the recursion adds more */
+template <typename T>
+struct augScratch {
+  std::unordered_map<T*, uint32_t> ids;
+  std::deque<std::vector<T*>> succs;
+  std::vector<uint32_t> seen;
+  std::vector<T*> visited;
+  uint32_t epoch = 0;
+  uint32_t id(T *node) {
+    auto it = ids.find(node);
+    if(it != ids.end()) {
+      return it->second;
+    }
+    uint32_t i = seen.size();
+    ids.emplace(node, i);
+    succs.emplace_back(node->getSuccs().begin(), node->getSuccs().end());
+    std::sort(succs.back().begin(), succs.back().end(), sortByIcnt<T*>());
+    seen.push_back(0);
+    return i;
+  }
+  bool isSeen(T *node) const {
+    auto it = ids.find(node);
+    return it != ids.end() and seen[it->second] == epoch;
+  }
+  void reset() {
+    visited.clear();
+    epoch++;
+  }
+};
+
 template <typename T>
 bool aug_dfs(T *node,
 	     T *target,
-	     std::set<T*> &seen,
-	     std::list<T*> &visited,
-	     const std::set<T*> &init,
+	     augScratch<T> &s,
 	     size_t curr_len, size_t max_len) {
   if(node == target) {
-    visited.push_back(node);
+    s.visited.push_back(node);
     return true;
   }
   if(curr_len >= max_len) {
     return false;
   }
 
-  auto it = seen.find(node);
-  if(it != seen.end())
+  uint32_t i = s.id(node);
+  if(s.seen[i] == s.epoch)
     return false;
-  seen.insert(node);
+  s.seen[i] = s.epoch;
 
-  if(node->hasJAL() /*or node->hasJR() or node->hasJALR()*/) {
+  if(node->hasMONITOR()) {
+    return false;
+  }
+  else if(node->hasJAL()) {
     bool viable = false;
     for(T *nn : node->getSuccs()) {
-      if((nn == target) or (seen.find(nn) != seen.end())) {
+      if((nn == target) or s.isSeen(nn)) {
 	viable = true;
 	break;
       }
@@ -171,23 +99,11 @@ bool aug_dfs(T *node,
   else if(node->hasJR() or node->hasJALR()) {
     return false;
   }
-  else if(node->hasMONITOR()) {
-    return false;
-  }
 
   bool found_path = false;
-  size_t num_succs = node->getSuccs().size();
-  std::vector<T*> succs;
-  succs.reserve(num_succs);
-  for(T *n : node->getSuccs()) {
-    succs.push_back(n);
-  }
-  
-  std::sort(succs.begin(), succs.end(), sortByIcnt<T*>());
-  
-  for(T *n : succs) {
-    if(aug_dfs(n, target, seen, visited, init, curr_len+1, max_len)) {
-      visited.push_back(node);
+  for(T *n : s.succs[i]) {
+    if(aug_dfs(n, target, s, curr_len+1, max_len)) {
+      s.visited.push_back(node);
       found_path = true;
     }
   }
@@ -224,6 +140,180 @@ void regionCFG::dropCompiled() {
     bb->dropCompiledCode();
   }
 }
+void regionCFG::evictColdRegions(const regionCFG *keep) {
+  const uint64_t cap = globals::codeCacheKB << 10;
+  if(cap == 0) {
+    return;
+  }
+  while(codeCacheBytes > cap) {
+    /* frequency decays with the number of region runs since
+     * the last one, coldest goes first */
+    regionCFG *victim = nullptr;
+    double coldest = 0.0;
+    for(regionCFG *r : regionCFGs) {
+      if(r == keep) {
+	continue;
+      }
+      double heat = static_cast<double>(r->runs + 1) / (1.0 + (iters - r->lastRun));
+      if(victim == nullptr or heat < coldest) {
+	victim = r;
+	coldest = heat;
+      }
+    }
+    if(victim == nullptr) {
+      break;
+    }
+    basicBlock *bb = victim->head;
+    assert(bb->cfgCplr == victim);
+    evictedHeads.insert(bb->getEntryAddr());
+    bb->cfgCplr = nullptr;
+    bb->hasRegion = false;
+    delete victim;
+    evictions++;
+  }
+}
+
+static bool reaches(basicBlock *from, basicBlock *to, const std::set<basicBlock*> &within) {
+  std::set<basicBlock*> seen = {from};
+  std::vector<basicBlock*> work = {from};
+  while(not(work.empty())) {
+    basicBlock *bb = work.back();
+    work.pop_back();
+    if(bb == to) {
+      return true;
+    }
+    for(basicBlock *nbb : bb->getSuccs()) {
+      if(within.find(nbb) != within.end() and seen.insert(nbb).second) {
+	work.push_back(nbb);
+      }
+    }
+  }
+  return false;
+}
+
+regionCFG *regionCFG::grow(regionCFG *r) {
+  basicBlock *tbb = basicBlock::globalFindBlock(r->growTarget);
+  r->growTarget = 0;
+  if(tbb == nullptr or not(tbb->readOnly) or r->blocks.find(tbb) != r->blocks.end()) {
+    return r;
+  }
+  std::vector<basicBlock*> tv = {tbb};
+  if(not(basicBlock::canCompileRegion(tv))) {
+    return r;
+  }
+  /* the exit has to be an edge the profile knows about or the
+   * new block isn't reachable in the region graph */
+  bool edge = false;
+  for(basicBlock *pbb : tbb->preds) {
+    edge |= (r->blocks.find(pbb) != r->blocks.end());
+  }
+  if(not(edge)) {
+    return r;
+  }
+  /* buildCFG only looks at the block set and the head, region
+   * augmentation pulls in the paths from tbb back to the head */
+  std::vector<std::vector<basicBlock*>> regions(1);
+  regions[0].push_back(r->head);
+  for(basicBlock *bb : r->blocks) {
+    if(bb != r->head) {
+      regions[0].push_back(bb);
+    }
+  }
+  regions[0].push_back(tbb);
+  regionCFG *g = new regionCFG();
+  if(not(g->buildCFG(regions))) {
+    delete g;
+    return r;
+  }
+  g->generation = r->generation + 1;
+  basicBlock *bb = r->head;
+  assert(bb->cfgCplr == r);
+  bb->cfgCplr = g;
+  delete r;
+  regionsGrown++;
+  evictColdRegions(g);
+  return g;
+}
+
+regionCFG *regionCFG::fuse(regionCFG *r) {
+  if(not(globals::fuseCFGs) or r->generation >= maxGenerations) {
+    return r;
+  }
+  regionCFG *o = nullptr;
+  for(regionCFG *c : regionCFGs) {
+    if(c == r or c->codeBits == nullptr or c->generation >= maxGenerations) {
+      continue;
+    }
+    uint64_t common = r->numBBInCommon(*c);
+    if(common != 0 and (2*common) >= std::min(r->blocks.size(), c->blocks.size())) {
+      o = c;
+      break;
+    }
+  }
+  if(o == nullptr) {
+    return r;
+  }
+  globals::nAttemptedFuses++;
+  std::set<basicBlock*> all(r->blocks);
+  all.insert(o->blocks.begin(), o->blocks.end());
+  /* either head will do as long as it reaches the other one */
+  basicBlock *h = nullptr;
+  if(reaches(r->head, o->head, all)) {
+    h = r->head;
+  }
+  else if(reaches(o->head, r->head, all)) {
+    h = o->head;
+  }
+  if(h == nullptr) {
+    return r;
+  }
+  std::vector<std::vector<basicBlock*>> regions(1);
+  regions[0].push_back(h);
+  for(basicBlock *bb : all) {
+    if(bb != h) {
+      regions[0].push_back(bb);
+    }
+  }
+  basicBlock *lh = (h == r->head) ? o->head : r->head;
+  assert(h->cfgCplr == r or h->cfgCplr == o);
+  assert(lh->cfgCplr == r or lh->cfgCplr == o);
+  /* the other head is left with a side entry, if it can have one */
+  lh->hasRegion = false;
+  regionCFG *f = new regionCFG();
+  if(not(f->buildCFG(regions))) {
+    delete f;
+    lh->hasRegion = true;
+    return r;
+  }
+  f->generation = std::max(r->generation, o->generation) + 1;
+  lh->cfgCplr = nullptr;
+  h->cfgCplr = f;
+  h->hasRegion = true;
+  delete r;
+  delete o;
+  globals::nFuses++;
+  return f;
+}
+
+void regionCFG::dropRegionsWith(const std::set<basicBlock*> &bbs) {
+  std::vector<regionCFG*> victims;
+  for(regionCFG *r : regionCFGs) {
+    for(basicBlock *bb : r->blocks) {
+      if(bbs.find(bb) != bbs.end()) {
+	victims.push_back(r);
+	break;
+      }
+    }
+  }
+  for(regionCFG *r : victims) {
+    basicBlock *bb = r->head;
+    assert(bb->cfgCplr == r);
+    bb->cfgCplr = nullptr;
+    bb->hasRegion = false;
+    delete r;
+  }
+}
+
 llvmRegTables::llvmRegTables(regionCFG *cfg) :
   MipsRegTable<llvm::Value>(),
   cfg(cfg),
@@ -261,6 +351,7 @@ llvm::Value *llvmRegTables::loadGPR(uint32_t gpr) {
       Value *gep = myIRBuilder->MakeGEP(cfg->blockArgMap["gpr"], offs);
       std::string ldName = getGPRName(gpr) + "_" + std::to_string(cfg->getuuid()++);
       Value *ld = myIRBuilder->MakeLoad(gep,ldName);
+      cfg->setTBAA(ld, cfg->tbaaGpr);
       gprTbl[gpr] = ld;
     }
   }
@@ -379,11 +470,15 @@ void llvmRegTables::initIcnt() {
   llvm::Value *vZ = llvm::ConstantInt::get(iType64,0);
   llvm::Value *vG = myIRBuilder->MakeGEP(cfg->blockArgMap["icnt"], vZ);
   iCnt = myIRBuilder->MakeLoad(vG, "");
+  cfg->setTBAA(iCnt, cfg->tbaaIcnt);
 }
 
-void llvmRegTables::incrIcnt(size_t amt) {
+void llvmRegTables::incrIcnt(int64_t amt) {
+  if(amt == 0) {
+    return;
+  }
   llvm::Type *iType64 = llvm::Type::getInt64Ty(*(cfg->Context));
-  llvm::Value *vAmt = llvm::ConstantInt::get(iType64,amt);
+  llvm::Value *vAmt = llvm::ConstantInt::get(iType64,amt,true);
   iCnt = myIRBuilder->CreateAdd(iCnt, vAmt);
 }
 void llvmRegTables::storeIcnt() {
@@ -391,13 +486,13 @@ void llvmRegTables::storeIcnt() {
   Type *iType64 = Type::getInt64Ty(*(cfg->Context));
   Value *vZ = ConstantInt::get(iType64,0);
   Value *vG = myIRBuilder->MakeGEP(cfg->blockArgMap["icnt"], vZ);
-  myIRBuilder->CreateStore(iCnt, vG);
+  cfg->setTBAA(myIRBuilder->CreateStore(iCnt, vG), cfg->tbaaIcnt);
 }
 void llvmRegTables::storeGPR(uint32_t gpr) {
   using namespace llvm;
   Value *offs = ConstantInt::get(Type::getInt32Ty(*(cfg->Context)),gpr);
   Value *gep = myIRBuilder->MakeGEP(cfg->blockArgMap["gpr"], offs);
-  myIRBuilder->CreateStore(gprTbl[gpr], gep);
+  cfg->setTBAA(myIRBuilder->CreateStore(gprTbl[gpr], gep), cfg->tbaaGpr);
 }
 void llvmRegTables::storeFPR(uint32_t fpr) {
   using namespace llvm;
@@ -428,6 +523,148 @@ void llvmRegTables::storeFCR(uint32_t fcr) {
   myIRBuilder->CreateStore(fcrTbl[fcr], gep);
 }
 
+/* strip constant adds so a slot addressed off sp and off an
+ * adjusted copy of sp land on the same root */
+static llvm::Value *memRoot(llvm::Value *v, uint32_t &disp) {
+  while(llvm::BinaryOperator *bo = llvm::dyn_cast<llvm::BinaryOperator>(v)) {
+    llvm::ConstantInt *c = llvm::dyn_cast<llvm::ConstantInt>(bo->getOperand(1));
+    if(bo->getOpcode() != llvm::Instruction::Add or c == nullptr) {
+      break;
+    }
+    disp += static_cast<uint32_t>(c->getZExtValue());
+    v = bo->getOperand(0);
+  }
+  if(llvm::ConstantInt *c = llvm::dyn_cast<llvm::ConstantInt>(v)) {
+    disp += static_cast<uint32_t>(c->getZExtValue());
+    return nullptr;
+  }
+  return v;
+}
+
+static bool memOverlap(const guestMemVal &m, llvm::Value *root,
+		       uint32_t disp, uint32_t width) {
+  /* different roots may point anywhere */
+  if(m.root != root) {
+    return true;
+  }
+  return (disp - m.disp) < m.width or (m.disp - disp) < width;
+}
+
+/* only sp and gp relative accesses are tracked, those are the
+ * spill and global slots worth forwarding */
+static inline bool trackMem(uint32_t rs1) {
+  return globals::memForward and (rs1 == 2 or rs1 == 3);
+}
+
+static const size_t maxMemTbl = 64;
+
+llvm::Value *llvmRegTables::loadMem(uint32_t rs1, int32_t disp, llvm::Type *ty,
+				    const std::string &name) {
+  using namespace llvm;
+  uint32_t width = ty->getPrimitiveSizeInBits() / 8;
+  uint32_t d = disp;
+  Value *root = memRoot(gprTbl[rs1], d);
+  if(curSlot >= 0) {
+    return myIRBuilder->CreateLoad(ty, cfg->stackSlots[curSlot].val, name);
+  }
+  /* the load may read a promoted slot */
+  cfg->writebackStackSlots(slotDirty);
+  if(trackMem(rs1)) {
+    for(const guestMemVal &m : memTbl) {
+      if(m.root == root and m.disp == d and m.width == width) {
+	if(m.fromStore) {
+	  regionCFG::memLoadsForwarded++;
+	}
+	else {
+	  regionCFG::memLoadsReused++;
+	}
+	return m.v;
+      }
+    }
+  }
+  /* pending stores this load may read are no longer dead */
+  for(guestMemVal &m : memTbl) {
+    if(m.st and memOverlap(m, root, d, width)) {
+      m.st = nullptr;
+    }
+  }
+  Value *vIMM = ConstantInt::get(Type::getInt32Ty(*cfg->Context), disp);
+  Value *vEA = myIRBuilder->CreateAdd(gprTbl[rs1], vIMM);
+  Value *vZEA = myIRBuilder->CreateZExt(vEA, Type::getInt64Ty(*cfg->Context));
+  Value *vGEP = myIRBuilder->MakeGEP(cfg->blockArgMap["mem"], vZEA);
+  Value *vPtr = myIRBuilder->CreateBitCast(vGEP, PointerType::get(ty, 0));
+  Value *vLoad = myIRBuilder->MakeLoad(vPtr, name);
+  cfg->setTBAA(vLoad, cfg->tbaaGuestMem);
+  if(trackMem(rs1)) {
+    if(memTbl.size() == maxMemTbl) {
+      memTbl.erase(memTbl.begin());
+    }
+    memTbl.push_back({root, d, width, vLoad, nullptr, false});
+  }
+  return vLoad;
+}
+
+void llvmRegTables::storeMem(uint32_t rs1, int32_t disp, llvm::Value *v) {
+  using namespace llvm;
+  uint32_t width = v->getType()->getPrimitiveSizeInBits() / 8;
+  uint32_t d = disp;
+  Value *root = memRoot(gprTbl[rs1], d);
+  bool track = trackMem(rs1);
+  StoreInst *dead = nullptr;
+  if(curSlot >= 0) {
+    myIRBuilder->CreateStore(v, cfg->stackSlots[curSlot].val);
+    slotDirty[curSlot] = true;
+    /* what was known about memory under other roots may be stale */
+    for(size_t i = 0; i < memTbl.size(); ) {
+      if(memOverlap(memTbl[i], root, d, width)) {
+	memTbl.erase(memTbl.begin() + i);
+      }
+      else {
+	i++;
+      }
+    }
+    return;
+  }
+  cfg->writebackStackSlots(slotDirty);
+  for(size_t i = 0; i < memTbl.size(); ) {
+    const guestMemVal &m = memTbl[i];
+    if(track and m.root == root and m.disp == d and m.width == width) {
+      if(m.v == v) {
+	/* memory already holds v */
+	regionCFG::memStoresElided++;
+	return;
+      }
+      dead = m.st;
+    }
+    if(memOverlap(m, root, d, width)) {
+      memTbl.erase(memTbl.begin() + i);
+    }
+    else {
+      i++;
+    }
+  }
+  if(dead) {
+    /* overwritten before anything could read it */
+    dead->eraseFromParent();
+    regionCFG::memStoresElided++;
+  }
+  Value *vIMM = ConstantInt::get(Type::getInt32Ty(*cfg->Context), disp);
+  Value *vEA = myIRBuilder->CreateAdd(gprTbl[rs1], vIMM);
+  Value *vZEA = myIRBuilder->CreateZExt(vEA, Type::getInt64Ty(*cfg->Context));
+  Value *vGEP = myIRBuilder->MakeGEP(cfg->blockArgMap["mem"], vZEA);
+  Value *vPtr = myIRBuilder->CreateBitCast(vGEP, PointerType::get(v->getType(), 0));
+  StoreInst *st = myIRBuilder->CreateStore(v, vPtr);
+  cfg->setTBAA(st, cfg->tbaaGuestMem);
+  if(track) {
+    if(memTbl.size() == maxMemTbl) {
+      memTbl.erase(memTbl.begin());
+    }
+    memTbl.push_back({root, d, width, v, st, true});
+  }
+  /* the store may have hit a promoted slot */
+  cfg->reloadStackSlots(*this);
+}
+
 void gprPhiNode::makeLLVMPhi(regionCFG *cfg, llvmRegTables& regTbl) {
   llvm::Type *iType32 = llvm::Type::getInt32Ty(*(cfg->Context));
   std::string phiName = getGPRName(gprId) + "_" + std::to_string(cfg->getuuid()++);
@@ -553,13 +790,13 @@ bool regionCFG::allBlocksReachable(cfgBasicBlock *root) {
 
 
 bool regionCFG::buildCFG(std::vector<std::vector<basicBlock*> > &regions) {
+  regionArena::scope arenaScope(&arena);
   compileTime = timestamp();
   std::set<basicBlock*> heads;
   std::map<basicBlock*, cfgBasicBlock*> cfgMap;
   std::vector<basicBlock*> blockvec;
   std::set<basicBlock*> discovered; 
-  std::list<basicBlock*> visited;
-  std::set<basicBlock*> seen;
+  augScratch<basicBlock> scratch;
   
   currCFG = this;
 
@@ -606,12 +843,9 @@ bool regionCFG::buildCFG(std::vector<std::vector<basicBlock*> > &regions) {
       /* find paths to the head bb */      
     case cfgAugEnum::head:
       for(auto bb: blockvec) {
-	visited.clear();
-	seen.clear();	
-	if(aug_dfs<basicBlock>(head, bb, seen, visited, blocks, 0, 1024)) {
-	  for(auto dbb : visited) {
-	    discovered.insert(dbb);
-	  }
+	scratch.reset();
+	if(aug_dfs<basicBlock>(head, bb, scratch, 0, 1024)) {
+	  discovered.insert(scratch.visited.begin(), scratch.visited.end());
 	}
       }
       break;
@@ -620,12 +854,9 @@ bool regionCFG::buildCFG(std::vector<std::vector<basicBlock*> > &regions) {
       for(auto bb : blockvec) {
 	for(auto nbb : blockvec) {
 	  if(bb==nbb) continue;
-	  visited.clear();
-	  seen.clear();
-	  if(aug_dfs<basicBlock>(nbb, bb, seen, visited, blocks, 0, 1024)) {
-	    for(auto dbb : visited) {
-	      discovered.insert(dbb);
-	    }
+	  scratch.reset();
+	  if(aug_dfs<basicBlock>(nbb, bb, scratch, 0, 1024)) {
+	    discovered.insert(scratch.visited.begin(), scratch.visited.end());
 	  }
 	}
       }
@@ -638,12 +869,9 @@ bool regionCFG::buildCFG(std::vector<std::vector<basicBlock*> > &regions) {
 	  auto *nbb = *dit;
 	  if(nbb==bb)
 	    continue;
-	  visited.clear();
-	  seen.clear();		  
-	  if(aug_dfs<basicBlock>(nbb, bb, seen, visited, blocks, 0, 1024)) {
-	    for(auto dbb : visited) {
-	      discovered.insert(dbb);
-	    }
+	  scratch.reset();
+	  if(aug_dfs<basicBlock>(nbb, bb, scratch, 0, 1024)) {
+	    discovered.insert(scratch.visited.begin(), scratch.visited.end());
 	  }
 	}
       }
@@ -675,7 +903,7 @@ bool regionCFG::buildCFG(std::vector<std::vector<basicBlock*> > &regions) {
       regionProb[nbb] += (pr * bb->edgeWeight(nbb->getEntryAddr()));
     }
   }
-  headProb = regionProb.at(head);
+  headProb = regionProb[head];
 
   //for(auto bb : blocks) {
     //uint32_t tgt,fallthru;
@@ -701,7 +929,7 @@ bool regionCFG::buildCFG(std::vector<std::vector<basicBlock*> > &regions) {
     if(bb == head) {
       cfgHead = cbb;
     }
-    cfgBlocks.push_back(cbb);
+    addCfgBlock(cbb);
     cfgMap[bb] = cbb;
   }
   
@@ -793,35 +1021,33 @@ bool regionCFG::buildCFG(std::vector<std::vector<basicBlock*> > &regions) {
   if(rc) {
     generateMachineCode(globals::regionOptLevel);
     compileTime = timestamp() - compileTime;
+    buildTime += compileTime;
+    regionsBuilt++;
+  }
+  arenaBytes += arena.allocatedBytes();
+  if(rc and globals::releaseIR) {
+    releaseIR();
   }
   return rc;
 }
 
 bool regionCFG::analyzeGraph() {
   entryBlock = new cfgBasicBlock(nullptr);
-  cfgBlocks.push_back(entryBlock);
+  addCfgBlock(entryBlock);
   entryBlock->addSuccessor(cfgHead);
+  addOSREntries();
   globals::nCfgCompiles++;
   
-  if(cfgBlocks.size() < 512) {
-    computeDominance();
-  }
-  else {
-    computeLengauerTarjanDominance();
-  }
+  double t0 = timestamp();
+  computeLengauerTarjanDominance();
 
   fastDominancePreComputation();
   
   computeDominanceFrontiers();
+  domTime += timestamp() - t0;
   /* search for natural loops */
   findNaturalLoops();
   
-  /* "compile" mips instructions into proper class */
-  for(size_t i = 0, n = cfgBlocks.size(); i < n; i++) {
-    cfgBasicBlock *cbb = cfgBlocks[i];
-    cbb->bindInsns(this);
-  }
-
   /* insert phis into basicblocks */
   insertPhis();
 
@@ -856,9 +1082,24 @@ bool regionCFG::analyzeGraph() {
     usesFCR |= (allFcrRead[i]!=0);
   }
 
+  if(globals::countInsns and globals::deferIcnt) {
+    computeIcntPotentials();
+  }
+  computeModifiedRegs();
+  findStackSlots();
+  
   initLLVMAndGeneratePreamble();
   entryBlock->traverseAndRename(this);
   entryBlock->patchUpPhiNodes(this);
+  sinkAbortBlocks();
+  if(not(stackSlots.empty())) {
+    std::vector<llvm::AllocaInst*> allocas;
+    for(const stackSlot &ss : stackSlots) {
+      allocas.push_back(ss.val);
+    }
+    llvm::DominatorTree DT(*blockFunction);
+    llvm::PromoteMemToReg(allocas, DT);
+  }
 
   
   std::string _errors;
@@ -871,6 +1112,15 @@ bool regionCFG::analyzeGraph() {
     die();
   }
 
+  if(globals::regionOptLevel != llvm::CodeGenOpt::None) {
+    runEarlyCSE();
+  }
+  if(globals::loopOpt and not(loopNesting.empty()) and
+     (globals::regionOptLevel != llvm::CodeGenOpt::None)) {
+    runLLVMLoopAnalysis();
+  }
+  runIRPipeline();
+  
   if(globals::dumpIR) {
     dumpIR();
     dumpLLVM();
@@ -880,6 +1130,20 @@ bool regionCFG::analyzeGraph() {
   return true;
 }
 
+static llvm::TargetMachine *getLoopTargetMachine() {
+  /* host target for the cost models used by the
+   * unroller and vectorizer, same cpu and features as
+   * the code generator */
+  static llvm::TargetMachine *tm = nullptr;
+  if(tm == nullptr) {
+    llvm::EngineBuilder eb;
+    eb.setMCPU(regionCFG::hostCPU());
+    eb.setMAttrs(regionCFG::hostFeatures());
+    tm = eb.selectTarget();
+  }
+  return tm;
+}
+
 void regionCFG::initLLVMAndGeneratePreamble() {
   std::vector<llvm::Type*> blockArgTypes;
   llvm::FunctionType *blockFunctionType = 0;
@@ -892,6 +1156,10 @@ void regionCFG::initLLVMAndGeneratePreamble() {
   Context = &globalContext;
   myIRBuilder = new llvm::IRBuilder<>(*Context);
   myModule = new llvm::Module(modName, *Context);
+  /* every pass sees the layout and triple codegen will use */
+  llvm::TargetMachine *tm = getLoopTargetMachine();
+  myModule->setDataLayout(tm->createDataLayout());
+  myModule->setTargetTriple(tm->getTargetTriple().str());
   type_iPtr32 = llvm::Type::getInt32PtrTy(*Context);
   type_void = llvm::Type::getVoidTy(*Context);
   type_iPtr8 = llvm::Type::getInt8PtrTy(*Context);
@@ -926,20 +1194,60 @@ void regionCFG::initLLVMAndGeneratePreamble() {
 
   llvm::ArrayRef<llvm::Type*> blockArgs(blockArgTypes);
   blockFunctionType = llvm::FunctionType::get(type_void,blockArgs,false);
-  blockFunction = llvm::Function::Create(blockFunctionType, 
+  entryFunction = llvm::Function::Create(blockFunctionType, 
 					 llvm::Function::ExternalLinkage,
 					 tempName, 
 					 myModule);
   size_t idx = 0;
-  for (auto AI = blockFunction->arg_begin(), E = blockFunction->arg_end();
+  for (auto AI = entryFunction->arg_begin(), E = entryFunction->arg_end();
        AI != E; ++AI) {
     AI->setName(blockArgNames[idx]);
     blockArgMap[blockArgNames[idx]] = &(*AI);
+    /* every argument points at its own object (guest memory,
+     * state_t fields or locals of regionCFG::run) */
+    AI->addAttr(llvm::Attribute::NoAlias);
     idx++;
   }
+  blockFunction = entryFunction;
 
-  /* first defined block must be entry */
-  entryBlock->lBB = llvm::BasicBlock::Create(*Context,tempName + "_ENTRY",blockFunction);
+  llvm::MDBuilder mdb(*Context);
+  llvm::MDNode *tbaaRoot = mdb.createTBAARoot("rv32 state");
+  llvm::MDNode *tyGuestMem = mdb.createTBAAScalarTypeNode("guest mem", tbaaRoot);
+  llvm::MDNode *tyGpr = mdb.createTBAAScalarTypeNode("gpr", tbaaRoot);
+  llvm::MDNode *tyIcnt = mdb.createTBAAScalarTypeNode("icnt", tbaaRoot);
+  llvm::MDNode *tyExit = mdb.createTBAAScalarTypeNode("exit", tbaaRoot);
+  tbaaGuestMem = mdb.createTBAAStructTagNode(tyGuestMem, tyGuestMem, 0);
+  tbaaGpr = mdb.createTBAAStructTagNode(tyGpr, tyGpr, 0);
+  tbaaIcnt = mdb.createTBAAStructTagNode(tyIcnt, tyIcnt, 0);
+  tbaaExit = mdb.createTBAAStructTagNode(tyExit, tyExit, 0);
+
+  if(globals::chainRegions) {
+    /* swaps blockFunction (and blockArgMap) for the ghccc body */
+    generateChainPreamble(tempName, blockFunctionType, blockArgNames);
+  }
+  else {
+    /* first defined block must be entry */
+    entryBlock->lBB = llvm::BasicBlock::Create(*Context,tempName + "_ENTRY",blockFunction);
+  }
+
+  if(globals::memGuard) {
+    /* a line table with the guest pc as line number, maps the
+     * host pc of a guest memory fault back to the insn */
+    llvm::DIBuilder dib(*myModule);
+    llvm::DIFile *file = dib.createFile(modName, ".");
+    llvm::DICompileUnit *cu =
+      dib.createCompileUnit(llvm::dwarf::DW_LANG_C, file, "rv32", true, "", 0, "",
+			    llvm::DICompileUnit::LineTablesOnly);
+    diSub = dib.createFunction(cu, tempName, tempName, file, 0,
+			       dib.createSubroutineType(dib.getOrCreateTypeArray({})), 0,
+			       llvm::DINode::FlagZero,
+			       llvm::DISubprogram::SPFlagDefinition |
+			       llvm::DISubprogram::SPFlagOptimized);
+    blockFunction->setSubprogram(diSub);
+    dib.finalize();
+    myModule->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+			    llvm::DEBUG_METADATA_VERSION);
+  }
 
   for(size_t i = 0; i < cfgBlocks.size(); i++) {
     if(cfgBlocks[i] == entryBlock)
@@ -952,6 +1260,129 @@ void regionCFG::initLLVMAndGeneratePreamble() {
 
 }
 
+/* a0-a4 carry arguments and return values, ra, sp and s0 are live
+ * across almost every region boundary. with ctx and the memory base
+ * this fills the ten argument registers of ghccc on x86-64 */
+const uint32_t regionCFG::chainGprs[] = {1, 2, 8, 10, 11, 12, 13, 14};
+const size_t regionCFG::numChainGprs = sizeof(chainGprs)/sizeof(chainGprs[0]);
+
+void regionCFG::generateChainPreamble(const std::string &name,
+				      llvm::FunctionType *entryType,
+				      const std::vector<std::string> &argNames) {
+  /* chained regions : the region proper is a ghccc function taking
+   * the hot guest registers and the memory base in host registers
+   * plus ctx, an array holding the remaining (pointer) arguments.
+   * an exit to a pc with a compiled region musttail calls that
+   * region's body, so a chain of regions runs without a round trip
+   * through run() or the register file. the C abi function run()
+   * calls builds ctx, loads the hot registers and calls the body.
+   *
+   * run() only sees the region a chain started in. by design the
+   * chain also skips regionSched::poll (queued heads wait for the
+   * next dispatch) and the dumpicnt check (dumps land at the end
+   * of the chain). the body counts its runs and stamps lastRun
+   * itself so eviction doesn't take a chained-to region for cold */
+  llvm::Type *ctxTy = type_iPtr8->getPointerTo();
+  std::vector<llvm::Type*> argTypes = {ctxTy, type_iPtr8};
+  for(size_t i = 0; i < numChainGprs; i++) {
+    argTypes.push_back(type_int32);
+  }
+  chainFunctionType = llvm::FunctionType::get(type_void, argTypes, false);
+  blockFunction = llvm::Function::Create(chainFunctionType,
+					 llvm::Function::ExternalLinkage,
+					 name + "_body",
+					 myModule);
+  blockFunction->setCallingConv(llvm::CallingConv::GHC);
+
+  llvm::Value *vCtxLen = llvm::ConstantInt::get(type_int32, argNames.size());
+  llvm::BasicBlock *wBB = llvm::BasicBlock::Create(*Context, "wrapper", entryFunction);
+  llvm::IRBuilder<> wb(wBB);
+  llvm::Value *wCtx = wb.CreateAlloca(type_iPtr8, vCtxLen);
+  std::vector<llvm::Value*> callArgs = {wCtx, blockArgMap.at("mem")};
+  for(size_t i = 0; i < numChainGprs; i++) {
+    llvm::Value *offs = llvm::ConstantInt::get(type_int32, chainGprs[i]);
+    llvm::Value *gep = wb.MakeGEP(blockArgMap.at("gpr"), offs);
+    llvm::Value *ld = wb.MakeLoad(gep, getGPRName(chainGprs[i]));
+    setTBAA(ld, tbaaGpr);
+    callArgs.push_back(ld);
+  }
+
+  /* first defined block must be entry */
+  entryBlock->lBB = llvm::BasicBlock::Create(*Context,name + "_ENTRY",blockFunction);
+  llvm::IRBuilder<> bb(entryBlock->lBB);
+  auto AI = blockFunction->arg_begin();
+  llvm::Value *bCtx = &(*AI++);
+  bCtx->setName("ctx");
+  for(size_t i = 0, n = argNames.size(); i < n; i++) {
+    llvm::Value *offs = llvm::ConstantInt::get(type_int32, i);
+    llvm::Value *arg = blockArgMap.at(argNames[i]);
+    wb.CreateStore(wb.CreateBitCast(arg, type_iPtr8), wb.MakeGEP(wCtx, offs));
+    if(argNames[i] == "mem") {
+      continue;
+    }
+    llvm::Value *ld = bb.MakeLoad(bb.MakeGEP(bCtx, offs), argNames[i]);
+    blockArgMap[argNames[i]] = bb.CreateBitCast(ld, entryType->getParamType(i));
+  }
+  /* runs++, lastRun = iters. the counters alias none of guest
+   * memory, registers or icnt */
+  uint32_t h = head->getEntryAddr();
+  llvm::Value *vRuns = bb.CreateIntToPtr(hostAddr(bb, hostReloc::runs, h, &runs), type_iPtr64);
+  llvm::Value *vLast = bb.CreateIntToPtr(hostAddr(bb, hostReloc::lastRun, h, &lastRun), type_iPtr64);
+  llvm::Value *vIters = bb.CreateIntToPtr(hostAddr(bb, hostReloc::iters, 0, &iters), type_iPtr64);
+  llvm::Value *vNRuns = bb.CreateLoad(type_int64, vRuns);
+  llvm::Value *vNIters = bb.CreateLoad(type_int64, vIters);
+  setTBAA(vNRuns, tbaaExit);
+  setTBAA(vNIters, tbaaExit);
+  vNRuns = bb.CreateAdd(vNRuns, llvm::ConstantInt::get(type_int64, 1));
+  setTBAA(bb.CreateStore(vNRuns, vRuns), tbaaExit);
+  setTBAA(bb.CreateStore(vNIters, vLast), tbaaExit);
+
+  blockArgMap["mem"] = &(*AI++);
+  blockArgMap["mem"]->setName("mem");
+  for(size_t i = 0; i < numChainGprs; i++) {
+    gprArgs[chainGprs[i]] = &(*AI++);
+    gprArgs[chainGprs[i]]->setName(getGPRName(chainGprs[i]));
+  }
+
+  llvm::CallInst *ci = wb.CreateCall(chainFunctionType, blockFunction, callArgs);
+  ci->setCallingConv(llvm::CallingConv::GHC);
+  wb.CreateRetVoid();
+}
+
+void regionCFG::generateChainExit(uint32_t target, llvmRegTables &regTbl) {
+  /* continue in the region at target if there is one and no guest
+   * store hit translated code, otherwise fall through to the exit */
+  llvm::BasicBlock *chainBB = llvm::BasicBlock::Create(*Context, "chain", blockFunction);
+  llvm::BasicBlock *retBB = llvm::BasicBlock::Create(*Context, "nochain", blockFunction);
+  abortBlocks.push_back(chainBB);
+  abortBlocks.push_back(retBB);
+
+  llvm::Type *slotTy = chainFunctionType->getPointerTo();
+  llvm::Value *vSlotAddr = hostAddr(*myIRBuilder, hostReloc::chainSlot, target, &chainSlots[target]);
+  llvm::Value *vSlot = myIRBuilder->CreateIntToPtr(vSlotAddr, slotTy->getPointerTo());
+  llvm::Value *vBody = myIRBuilder->CreateLoad(slotTy, vSlot);
+  llvm::Value *vPendAddr = hostAddr(*myIRBuilder, hostReloc::codeWritePending, 0,
+				     const_cast<sig_atomic_t*>(&codeWritePending));
+  llvm::Value *vPend = myIRBuilder->CreateIntToPtr(vPendAddr, type_iPtr32);
+  llvm::Value *vWrite = myIRBuilder->CreateLoad(type_int32, vPend, true);
+  llvm::Value *vGo = myIRBuilder->CreateAnd(myIRBuilder->CreateIsNotNull(vBody),
+					     myIRBuilder->CreateIsNull(vWrite));
+  myIRBuilder->CreateCondBr(vGo, chainBB, retBB);
+
+  myIRBuilder->SetInsertPoint(chainBB);
+  std::vector<llvm::Value*> callArgs = {&(*blockFunction->arg_begin()), blockArgMap.at("mem")};
+  for(size_t i = 0; i < numChainGprs; i++) {
+    callArgs.push_back(regTbl.gprTbl[chainGprs[i]]);
+  }
+  llvm::CallInst *ci = myIRBuilder->CreateCall(chainFunctionType, vBody, callArgs);
+  ci->setCallingConv(llvm::CallingConv::GHC);
+  ci->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  myIRBuilder->CreateRetVoid();
+
+  myIRBuilder->SetInsertPoint(retBB);
+  chainExitsEmitted++;
+}
+
 regionCFG::regionCFG() : execUnit() {
   regionCFGs.insert(this);
   perfectNest = true;
@@ -968,11 +1399,16 @@ regionCFG::regionCFG() : execUnit() {
   entryBlock = 0;
   Context = 0;
   blockFunction = 0;
+  diSub = nullptr;
+  entryFunction = nullptr;
+  chainFunctionType = nullptr;
+  gprArgs.fill(nullptr);
   hasBoth = false;
   validDominanceAcceleration = false;
   compileTime = 0.0;
   myIRBuilder=nullptr;
   myModule= nullptr;
+  tbaaGuestMem = tbaaGpr = tbaaIcnt = tbaaExit = nullptr;
   myEngineBuilder=nullptr;
   myExecEngine=nullptr;
   allFprTouched.resize(32, fprUseEnum::unused);
@@ -980,7 +1416,16 @@ regionCFG::regionCFG() : execUnit() {
 }
 regionCFG::~regionCFG() {
   regionCFGs.erase(regionCFGs.find(this));
+  codeCacheBytes -= codeBytes;
   pmap->relReference();
+  if(chainSlot and *chainSlot == chainBody) {
+    *chainSlot = nullptr;
+  }
+  for(basicBlock *bb : osrBlocks) {
+    if(bb->osrCfg == this) {
+      bb->osrCfg = nullptr;
+    }
+  }
   
   for(auto cblk : cfgBlocks) {
     delete cblk;
@@ -1061,6 +1506,412 @@ void regionCFG::insertPhis()  {
   }
 }
 
+void regionCFG::computeModifiedRegs() {
+  /* forward may-modify dataflow over the region, entryBlock is
+   * in the definition sets only to seed phi insertion */
+  std::map<cfgBasicBlock*, std::bitset<32>> defs;
+  for(size_t gpr = 1; gpr < 32; gpr++) {
+    for(cfgBasicBlock *cbb : gprDefinitionBlocks[gpr]) {
+      if(cbb != entryBlock) {
+	defs[cbb][gpr] = true;
+      }
+    }
+  }
+  std::vector<cfgBasicBlock*> topo;
+  toposort(topo);
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(cfgBasicBlock *cbb : topo) {
+      std::bitset<32> m = defs[cbb];
+      for(cfgBasicBlock *pbb : cbb->preds) {
+	m |= pbb->gprModified;
+      }
+      if(m != cbb->gprModified) {
+	cbb->gprModified = m;
+	changed = true;
+      }
+    }
+  }
+}
+
+/* sp offset from the region entry sp, unknownSp once it has been
+ * written by anything but addi sp,sp,imm or paths disagree */
+static const int64_t unknownSp = std::numeric_limits<int64_t>::max();
+
+static int64_t spStep(uint32_t inst, int64_t d) {
+  riscv_t r(inst);
+  uint32_t opc = inst & 127;
+  if(r.i.rd != 2 or opc == 0x23 or opc == 0x63 or d == unknownSp) {
+    return d;
+  }
+  if(opc != 0x13 or ((inst>>12)&7) != 0 or r.i.rs1 != 2) {
+    return unknownSp;
+  }
+  return static_cast<int32_t>(d + (static_cast<int32_t>(inst) >> 20));
+}
+
+/* sp relative word slot touched by a load or store at sp offset d,
+ * width is 0 for anything else */
+static int64_t spSlot(uint32_t inst, int64_t d, uint32_t &width) {
+  static const uint32_t widths[8] = {1,2,4,0,1,2,0,0};
+  riscv_t r(inst);
+  uint32_t opc = inst & 127;
+  width = 0;
+  if(opc != 0x3 and opc != 0x23) {
+    return unknownSp;
+  }
+  width = widths[(inst>>12)&7];
+  uint32_t rs1 = (opc == 0x3) ? r.l.rs1 : r.s.rs1;
+  int32_t disp = (opc == 0x3) ? r.l.imm11_0 : (r.s.imm4_0 | (r.s.imm11_5 << 5));
+  disp |= ((inst>>31)&1) ? 0xfffff000 : 0x0;
+  if(rs1 != 2 or d == unknownSp) {
+    return unknownSp;
+  }
+  return static_cast<int32_t>(d + disp);
+}
+
+void regionCFG::findStackSlots() {
+  /* where sp is the entry sp plus a known constant, aligned word
+   * accesses off sp name fixed slots. every other guest access
+   * (including sp relative ones where the offset is unknown) may
+   * alias a slot */
+  stackSlots.clear();
+  for(cfgBasicBlock *cbb : cfgBlocks) {
+    cbb->stackSlotOf.clear();
+  }
+  if(not(globals::promoteStack)) {
+    return;
+  }
+  std::map<cfgBasicBlock*, int64_t> spIn;
+  std::vector<cfgBasicBlock*> work;
+  spIn[entryBlock] = 0;
+  work.push_back(entryBlock);
+  while(not(work.empty())) {
+    cfgBasicBlock *cbb = work.back();
+    work.pop_back();
+    int64_t d = spIn.at(cbb);
+    for(const auto &p : cbb->rawInsns) {
+      d = spStep(p.first, d);
+    }
+    for(cfgBasicBlock *sbb : cbb->succs) {
+      auto it = spIn.find(sbb);
+      if(it == spIn.end()) {
+	spIn[sbb] = d;
+	work.push_back(sbb);
+      }
+      else if(it->second != d and it->second != unknownSp) {
+	it->second = unknownSp;
+	work.push_back(sbb);
+      }
+    }
+  }
+
+  std::map<int32_t, bool> slots;
+  std::vector<std::pair<int64_t,int64_t>> partial;
+  size_t nSlotOps = 0, nOtherOps = 0;
+  for(auto &p : spIn) {
+    int64_t d = p.second;
+    for(const auto &ip : p.first->rawInsns) {
+      uint32_t w = 0;
+      int64_t offs = spSlot(ip.first, d, w);
+      d = spStep(ip.first, d);
+      if(w == 0) {
+	continue;
+      }
+      if(offs == unknownSp) {
+	nOtherOps++;
+      }
+      else if(w == 4 and (offs & 3) == 0) {
+	slots[offs] |= ((ip.first & 127) == 0x23);
+	nSlotOps++;
+      }
+      else {
+	partial.push_back({offs, offs + w});
+	nOtherOps++;
+      }
+    }
+  }
+  /* sub-word or unaligned sp accesses pin the words they touch */
+  for(const auto &pr : partial) {
+    for(auto it = slots.begin(); it != slots.end(); ) {
+      if(it->first < pr.second and pr.first < (it->first + 4)) {
+	it = slots.erase(it);
+      }
+      else {
+	++it;
+      }
+    }
+  }
+  std::map<int32_t, int32_t> slotIds;
+  for(const auto &sl : slots) {
+    slotIds[sl.first] = stackSlots.size();
+    stackSlots.push_back({sl.first, sl.second, nullptr, nullptr});
+  }
+
+  std::map<cfgBasicBlock*, std::vector<int32_t>> slotOf;
+  size_t nPromoted = 0;
+  for(auto &p : spIn) {
+    int64_t d = p.second;
+    std::vector<int32_t> &v = slotOf[p.first];
+    for(const auto &ip : p.first->rawInsns) {
+      uint32_t w = 0;
+      int64_t offs = spSlot(ip.first, d, w);
+      d = spStep(ip.first, d);
+      auto it = slotIds.find(offs);
+      if(w == 4 and offs != unknownSp and it != slotIds.end()) {
+	v.push_back(it->second);
+	nPromoted++;
+      }
+      else {
+	v.push_back(-1);
+      }
+    }
+  }
+  /* every other guest access costs a write back (and a reload
+   * for stores) of the slots */
+  if(nPromoted == 0 or nPromoted <= (nOtherOps + (nSlotOps - nPromoted))) {
+    stackSlots.clear();
+    return;
+  }
+  for(auto &p : slotOf) {
+    p.first->stackSlotOf = std::move(p.second);
+  }
+  stackSlotsPromoted += stackSlots.size();
+  stackOpsPromoted += nPromoted;
+}
+
+void regionCFG::initStackSlots(llvmRegTables &regTbl) {
+  using namespace llvm;
+  regTbl.slotDirty.assign(stackSlots.size(), false);
+  if(stackSlots.empty()) {
+    return;
+  }
+  Value *vSP = regTbl.gprTbl[2];
+  dbt_assert(vSP != nullptr);
+  for(stackSlot &ss : stackSlots) {
+    std::string n = "slot_" + std::to_string(ss.offs);
+    ss.val = myIRBuilder->CreateAlloca(type_int32, nullptr, n);
+    Value *vEA = myIRBuilder->CreateAdd(vSP, ConstantInt::get(type_int32, ss.offs));
+    Value *vZEA = myIRBuilder->CreateZExt(vEA, type_int64);
+    Value *vGEP = myIRBuilder->MakeGEP(blockArgMap["mem"], vZEA);
+    ss.ptr = myIRBuilder->CreateBitCast(vGEP, type_iPtr32);
+    Value *ld = myIRBuilder->CreateLoad(type_int32, ss.ptr);
+    setTBAA(ld, tbaaGuestMem);
+    myIRBuilder->CreateStore(ld, ss.val);
+    stackOpsMaterialized++;
+  }
+}
+
+void regionCFG::writebackStackSlots(std::vector<bool> &dirty) {
+  for(size_t i = 0, n = stackSlots.size(); i < n; i++) {
+    if(not(dirty[i])) {
+      continue;
+    }
+    llvm::Value *v = myIRBuilder->CreateLoad(type_int32, stackSlots[i].val);
+    setTBAA(myIRBuilder->CreateStore(v, stackSlots[i].ptr), tbaaGuestMem);
+    dirty[i] = false;
+    stackOpsMaterialized++;
+  }
+}
+
+void regionCFG::reloadStackSlots(llvmRegTables &regTbl) {
+  /* guest loads emitted here can read pending stores */
+  for(guestMemVal &m : regTbl.memTbl) {
+    m.st = nullptr;
+  }
+  for(stackSlot &ss : stackSlots) {
+    llvm::Value *ld = myIRBuilder->CreateLoad(type_int32, ss.ptr);
+    setTBAA(ld, tbaaGuestMem);
+    myIRBuilder->CreateStore(ld, ss.val);
+    stackOpsMaterialized++;
+  }
+}
+
+llvm::Value *regionCFG::emitHLECall(int32_t fn, llvmRegTables &regTbl) {
+  /* the host routine reads and writes guest memory behind our back */
+  writebackStackSlots(regTbl.slotDirty);
+  regTbl.memTbl.clear();
+
+  llvm::Type *args[] = {type_int32, type_iPtr8, type_int32, type_int32,
+			type_int32, type_iPtr32, type_iPtr64};
+  llvm::FunctionType *ty = llvm::FunctionType::get(type_int32, args, false);
+  llvm::FunctionCallee hle;
+  if(sharedModule) {
+    /* a shared object calls through the relocation table */
+    llvm::Value *vFn = hostAddr(*myIRBuilder, hostReloc::hle, 0,
+				reinterpret_cast<void*>(&rv32_hle));
+    hle = llvm::FunctionCallee(ty, myIRBuilder->CreateIntToPtr(vFn, ty->getPointerTo()));
+  }
+  else {
+    hle = myModule->getOrInsertFunction("rv32_hle", ty);
+  }
+  /* keep the allocas out of any loop */
+  llvm::BasicBlock &eBB = blockFunction->getEntryBlock();
+  llvm::IRBuilder<> eb(&eBB, eBB.begin());
+  llvm::Value *vRv = eb.CreateAlloca(type_int32);
+  llvm::Value *vCost = eb.CreateAlloca(type_int64);
+  
+  llvm::Value *vFn = llvm::ConstantInt::get(type_int32, fn);
+  llvm::Value *cArgs[] = {vFn, blockArgMap["mem"], regTbl.gprTbl[10],
+			  regTbl.gprTbl[11], regTbl.gprTbl[12], vRv, vCost};
+  llvm::Value *vDone = myIRBuilder->CreateCall(hle, cArgs);
+  regTbl.gprTbl[10] = myIRBuilder->CreateLoad(type_int32, vRv);
+  if(globals::countInsns) {
+    llvm::Value *c = myIRBuilder->CreateLoad(type_int64, vCost);
+    regTbl.iCnt = myIRBuilder->CreateAdd(regTbl.iCnt, c);
+  }
+  reloadStackSlots(regTbl);
+  hleCallsEmitted++;
+  return myIRBuilder->CreateIsNotNull(vDone);
+}
+
+void regionCFG::addOSREntries() {
+  /* side entries are extra edges out of entryBlock, the entry
+   * code dispatches on the pc run() was called with and ssa
+   * construction treats them like any other edge. an edge into
+   * a loop body makes the loop irreducible and costs it the loop
+   * optimizations, so by default only blocks first reached in
+   * their strongly connected component (outside of any loop, or
+   * the header of an outermost loop) get one */
+  osrBlocks.clear();
+  if(globals::osrEntries == osrEnum::none) {
+    return;
+  }
+  /* tarjan, a component's root is the first block the dfs reaches */
+  const size_t nBlocks = cfgBlocks.size();
+  std::vector<uint32_t> index(nBlocks, 0), low(nBlocks, 0);
+  std::vector<bool> onStack(nBlocks, false), isRoot(nBlocks, false);
+  std::vector<cfgBasicBlock*> stack;
+  uint32_t cnt = 0;
+  std::function<void(cfgBasicBlock*)> scc = [&](cfgBasicBlock *cbb) {
+    size_t u = cbb->blockId;
+    index[u] = low[u] = ++cnt;
+    stack.push_back(cbb);
+    onStack[u] = true;
+    for(cfgBasicBlock *sbb : cbb->succs) {
+      size_t v = sbb->blockId;
+      if(index[v] == 0) {
+	scc(sbb);
+	low[u] = std::min(low[u], low[v]);
+      }
+      else if(onStack[v]) {
+	low[u] = std::min(low[u], index[v]);
+      }
+    }
+    if(low[u] == index[u]) {
+      isRoot[u] = true;
+      cfgBasicBlock *w = nullptr;
+      do {
+	w = stack.back();
+	stack.pop_back();
+	onStack[w->blockId] = false;
+      } while(w != cbb);
+    }
+  };
+  scc(cfgHead);
+
+  std::vector<cfgBasicBlock*> entries;
+  for(cfgBasicBlock *cbb : cfgBlocks) {
+    if(cbb == entryBlock or cbb == cfgHead) {
+      continue;
+    }
+    if(globals::osrEntries == osrEnum::safe and not(isRoot[cbb->blockId])) {
+      continue;
+    }
+    /* the runtime enters at basicBlock boundaries only, and
+     * blocks that head their own region run that instead */
+    basicBlock *bb = cbb->bb;
+    if(bb->getEntryAddr() != cbb->getEntryAddr() or bb->hasRegion) {
+      continue;
+    }
+    entries.push_back(cbb);
+    osrBlocks.insert(bb);
+  }
+  for(cfgBasicBlock *cbb : entries) {
+    entryBlock->addSuccessor(cbb);
+  }
+  osrEntriesEmitted += entries.size();
+}
+
+void regionCFG::computeIcntPotentials() {
+  /* Instruction counting with increments only on edges outside of a
+   * maximum (by profiled frequency) spanning tree of the region graph
+   * plus a virtual exit node. Every block v puts |v| on its incoming
+   * edges, a potential per block moves these weights so that tree edges 
+   * carry nothing while every entry-to-exit walk keeps its sum. What is 
+   * left is an add on cold edges and a per-exit constant at each abort. */
+  struct edge {
+    size_t u, v;
+    double freq;
+  };
+  const size_t nBlocks = cfgBlocks.size(), exitId = nBlocks;
+  std::vector<edge> edges;
+  for(size_t i = 0; i < nBlocks; i++) {
+    cfgBasicBlock *cbb = cfgBlocks[i];
+    double outFreq = 0.0;
+    for(cfgBasicBlock *sbb : cbb->succs) {
+      double f = cbb->edgeFreq(sbb);
+      outFreq += f;
+      edges.push_back({i, sbb->blockId, f});
+    }
+    if(cbb != entryBlock) {
+      edges.push_back({i, exitId, std::max(0.0, cbb->execFreq() - outFreq)});
+    }
+  }
+  std::stable_sort(edges.begin(), edges.end(),
+		   [](const edge &a, const edge &b) { return a.freq > b.freq; });
+
+  /* kruskal */
+  std::vector<size_t> uf(nBlocks+1);
+  std::vector<std::vector<std::pair<size_t, int64_t>>> tree(nBlocks+1);
+  std::function<size_t(size_t)> find = [&](size_t x) {
+    while(uf[x] != x) {
+      x = uf[x] = uf[uf[x]];
+    }
+    return x;
+  };
+  for(size_t i = 0; i <= nBlocks; i++) {
+    uf[i] = i;
+  }
+  auto addTreeEdge = [&](size_t u, size_t v, int64_t w) {
+    uf[find(u)] = find(v);
+    tree[u].push_back({v, w});
+    tree[v].push_back({u, -w});
+  };
+  size_t entryId = entryBlock->blockId;
+  addTreeEdge(exitId, entryId, 0);
+  for(const edge &e : edges) {
+    if(find(e.u) == find(e.v)) {
+      continue;
+    }
+    int64_t w = (e.v == exitId) ? 0 : cfgBlocks[e.v]->insns.size();
+    addTreeEdge(e.u, e.v, w);
+  }
+
+  /* potentials so that w + pot(u) - pot(v) == 0 on tree edges */
+  std::vector<int64_t> pot(nBlocks+1, 0);
+  std::vector<bool> seen(nBlocks+1, false);
+  std::list<size_t> workList;
+  seen[entryId] = true;
+  workList.push_back(entryId);
+  while(not(workList.empty())) {
+    size_t u = workList.front();
+    workList.pop_front();
+    for(const auto &p : tree[u]) {
+      if(not(seen[p.first])) {
+	seen[p.first] = true;
+	pot[p.first] = pot[u] + p.second;
+	workList.push_back(p.first);
+      }
+    }
+  }
+  assert(pot[exitId] == 0);
+  for(size_t i = 0; i < nBlocks; i++) {
+    cfgBlocks[i]->icntPotential = pot[i];
+  }
+}
+
 void regionCFG::fastDominancePreComputation() {
   using namespace std;
   size_t cnt = 0;
@@ -1094,99 +1945,12 @@ void regionCFG::fastDominancePreComputation() {
 }
 
 void regionCFG::computeLengauerTarjanDominance() {
-  LengauerTarjanDominators LTD(cfgBlocks);
+  LengauerTarjanDominators<cfgBasicBlock> LTD(cfgBlocks, entryBlock);
   LTD();
-  
-}
- 
-void regionCFG::computeDominance() {
-  using namespace boost;
-  using namespace std;
-  bool changed = true;
-  vector<cfgBasicBlock*> preOrderVisit(cfgBlocks.size());
-  std::map<cfgBasicBlock*, size_t> blockToNumMap;
-  
-  map<cfgBasicBlock*, dynamic_bitset<>> domMap;
-  
-  size_t dfsNum = 0;
-
-  /* use DFS to compute DFS numbers */
-  function<void(cfgBasicBlock*)> dfs =[&](cfgBasicBlock* bb) {
-    preOrderVisit.at(dfsNum) = bb;
-    blockToNumMap[bb] = dfsNum;
-    dfsNum++;
-    domMap[bb] = dynamic_bitset<>(cfgBlocks.size());
-    domMap.at(bb).set();
-    for(auto nbb : bb->succs) {
-      auto it = blockToNumMap.find(nbb);
-      if(it == blockToNumMap.end()) {
-	dfs(nbb);
-      }
-    }
-  };
-  
-  /* initialize */
-  dfs(entryBlock);
-
-  domMap.at(entryBlock).reset();
-  domMap.at(entryBlock)[0] = true;
-
-  
-  /* compute dominators */
-  do {
-    changed = false;
-    for(size_t bId=0, n=preOrderVisit.size(); bId < n; bId++) {
-      cfgBasicBlock *cbb = preOrderVisit[bId];
-      dynamic_bitset<> tdd = domMap.at(cbb);
-      for(cfgBasicBlock *nbb : cbb->getPreds()) {
-	tdd &= domMap.at(nbb);
-      }
-      tdd[bId] = true;
-      //check if changed
-      if(tdd != domMap.at(cbb)) {
-	changed = true;
-	domMap.at(cbb) = tdd;
-      }
-    }
-  }
-  while(changed);
-  
-  for(size_t i = 1, n = preOrderVisit.size(); i < n; i++) {
-    cfgBasicBlock *cbb = preOrderVisit[i];
-    dynamic_bitset<> &dom = domMap.at(cbb);
-    dom[i] = false;
-    /* iterate over blocks that dominate current block */
-    for(size_t j = dom.find_first(); j != dynamic_bitset<>::npos; j = dom.find_next(j)) {
-      const dynamic_bitset<> &ddom = domMap.at(preOrderVisit.at(j));
-      for(size_t k = ddom.find_first(); k != dynamic_bitset<>::npos; k = ddom.find_next(k)) {
-	/* if j dominates k, k can not be the immediate dominator */
-	if(k!=j)
-	  dom[k]=false;
-      }
-    }
-    cbb->getIdom() = preOrderVisit.at(dom.find_first());
-    cbb->getIdom()->addDTreeSucc(cbb);
-  }
-  entryBlock->getIdom() = nullptr;
 }
  
 void regionCFG::computeDominanceFrontiers() {
-  /* compute dominance frontiers */
-  for(auto cbb : cfgBlocks) {
-    /* only blocks with more than one pred
-     * can update dominance frontiers */
-    if(cbb->preds.size() > 1) {
-      for(auto nbb : cbb->getPreds()) {
-	/* iterate back to idom 
-	 * adding this node to 
-	 * appropriate dominance frontiers */
-	while((nbb != cbb->getIdom())) {
-	    nbb->dfrontier.insert(cbb);
-	    nbb = nbb->getIdom();
-	  }
-      }
-    }
-  }
+  ::computeDominanceFrontiers(cfgBlocks);
 }
 
 bool regionCFG::dominates(cfgBasicBlock *A, cfgBasicBlock *B) const {
@@ -1261,7 +2025,14 @@ void fcrPhiNode::addIncomingEdge(regionCFG *cfg, cfgBasicBlock *b) {
 }
 void icntPhiNode::addIncomingEdge(regionCFG *cfg, cfgBasicBlock *b) {
   llvm::Value *vICnt = b->termRegTbl.iCnt;
-  lPhi->addIncoming(vICnt,getLLVMParentBlock(b));
+  llvm::BasicBlock *pBB = getLLVMParentBlock(b);
+  int64_t amt = globals::deferIcnt ? b->icntEdgeIncr(blk) : 0;
+  if(amt != 0) {
+    /* edge increment goes at the end of the predecessor */
+    llvm::IRBuilder<> eBuilder(pBB->getTerminator());
+    vICnt = eBuilder.CreateAdd(vICnt, llvm::ConstantInt::get(cfg->type_int64,amt,true));
+  }
+  lPhi->addIncoming(vICnt,pBB);
 }
 
 
@@ -1376,6 +2147,7 @@ llvm::BasicBlock* regionCFG::generateAbortBasicBlock(llvm::Value *abortpc,
   llvm::BasicBlock *saveBB = myIRBuilder->GetInsertBlock();
   llvm::BasicBlock *abortBB = llvm::BasicBlock::Create(*Context,abortName,
 						       blockFunction);
+  abortBlocks.push_back(abortBB);
  
   myIRBuilder->SetInsertPoint(abortBB);
 
@@ -1383,47 +2155,98 @@ llvm::BasicBlock* regionCFG::generateAbortBasicBlock(llvm::Value *abortpc,
   llvm::Value *offs = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Context),0);
   llvm::Value *gep = myIRBuilder->MakeGEP(blockArgMap["pc"], offs);
   llvm::Value *vPtr = myIRBuilder->CreateBitCast(gep, llvm::Type::getInt32PtrTy(*Context));
-  myIRBuilder->CreateStore(abortpc,vPtr);
+  setTBAA(myIRBuilder->CreateStore(abortpc,vPtr), tbaaExit);
 
   std::stringstream ss;
   ss << "abort_from_" << std::hex << cBB->bb->getEntryAddr() << std::dec;
-  llvm::Value *vNPC = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*Context),(uint64_t)(cBB->bb));
+  llvm::Value *vNPC = hostAddr(*myIRBuilder, hostReloc::bb, cBB->bb->getEntryAddr(), cBB->bb);
   gep = myIRBuilder->MakeGEP(blockArgMap["abortloc"], offs);
   vPtr = myIRBuilder->CreateBitCast(gep, llvm::Type::getInt64PtrTy(*Context));
-  myIRBuilder->CreateStore(vNPC,vPtr);
+  setTBAA(myIRBuilder->CreateStore(vNPC,vPtr), tbaaExit);
 
   llvm::Value *vAPC = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Context), cBB->getEntryAddr());
   gep = myIRBuilder->MakeGEP(blockArgMap["abortpc"], offs);
   vPtr = myIRBuilder->CreateBitCast(gep, llvm::Type::getInt32PtrTy(*Context));
-  myIRBuilder->CreateStore(vAPC,vPtr);
+  setTBAA(myIRBuilder->CreateStore(vAPC,vPtr), tbaaExit);
   
 
   /* we can't statically determine the next basic block */
   llvm::Value *vNBB = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*Context),(uint64_t)nullptr);
   gep = myIRBuilder->MakeGEP(blockArgMap["nextbb"], offs);
   vPtr = myIRBuilder->CreateBitCast(gep, llvm::Type::getInt64PtrTy(*Context));
-  myIRBuilder->CreateStore(vNBB,vPtr);
+  setTBAA(myIRBuilder->CreateStore(vNBB,vPtr), tbaaExit);
+
 
 
+  if(not(stackSlots.empty())) {
+    std::vector<bool> dirty(regTbl.slotDirty);
+    writebackStackSlots(dirty);
+  }
 
+  /* only write back registers dirtied on a path reaching this
+   * exit, a value still equal to the entry load is clean too */
+  const llvmRegTables &entryTbl = entryBlock->termRegTbl;
+  /* without guard page replay nothing reads the register file
+   * while chained regions run, registers passed between them are
+   * only stored when leaving for good */
+  bool lateHotStores = globals::chainRegions and not(globals::memGuard);
   for(size_t i = 0; i < 32; i++) {
-    if(!gprDefinitionBlocks[i].empty())
-      regTbl.storeGPR(i);
+    if(gprDefinitionBlocks[i].empty())
+      continue;
+    if(lateHotStores and gprArgs[i])
+      continue;
+    if(not(cBB->gprModified[i]) or (regTbl.gprTbl[i] == entryTbl.gprTbl[i])) {
+      exitStoresElided++;
+      continue;
+    }
+    regTbl.storeGPR(i);
+    exitStores++;
   }
   
 
   for(size_t i = 0; i < 32; i++) {
-    if(!fprDefinitionBlocks[i].empty())
-      regTbl.storeFPR(i);
+    if(fprDefinitionBlocks[i].empty())
+      continue;
+    if(regTbl.fprTbl[i] == entryTbl.fprTbl[i]) {
+      exitStoresElided++;
+      continue;
+    }
+    regTbl.storeFPR(i);
+    exitStores++;
   }
   
   for(size_t i = 0; i < 5; i++) {
-    if(!fcrDefinitionBlocks[i].empty())
-      regTbl.storeFCR(i);
+    if(fcrDefinitionBlocks[i].empty())
+      continue;
+    if(regTbl.fcrTbl[i] == entryTbl.fcrTbl[i]) {
+      exitStoresElided++;
+      continue;
+    }
+    regTbl.storeFCR(i);
+    exitStores++;
   }
 
   if(globals::countInsns) {
-    regTbl.storeIcnt();
+    if(globals::deferIcnt and cBB->icntExitIncr() != 0) {
+      llvmRegTables exitTbl(regTbl);
+      exitTbl.incrIcnt(cBB->icntExitIncr());
+      exitTbl.storeIcnt();
+    }
+    else {
+      regTbl.storeIcnt();
+    }
+  }
+
+  if(globals::chainRegions) {
+    if(auto *vTarget = llvm::dyn_cast<llvm::ConstantInt>(abortpc)) {
+      generateChainExit(vTarget->getZExtValue(), regTbl);
+    }
+    /* a chained entry may have brought in values the register
+     * file never saw */
+    for(size_t i = 0; lateHotStores and (i < numChainGprs); i++) {
+      regTbl.storeGPR(chainGprs[i]);
+      exitStores++;
+    }
   }
   
   myIRBuilder->CreateRetVoid();  
@@ -1437,14 +2260,217 @@ llvm::BasicBlock* regionCFG::generateAbortBasicBlock(llvm::Value *abortpc,
 
 
 
+llvm::MDNode *regionCFG::branchWeights(uint64_t t, uint64_t nt) const {
+  if(not(globals::branchWeights) or (t + nt) == 0) {
+    return nullptr;
+  }
+  /* weights are 32 bits, keep the ratio */
+  while(std::max(t, nt) > std::numeric_limits<uint32_t>::max()) {
+    t >>= 1;
+    nt >>= 1;
+  }
+  llvm::MDBuilder mdb(*Context);
+  return mdb.createBranchWeights(static_cast<uint32_t>(t), static_cast<uint32_t>(nt));
+}
+
+void regionCFG::sinkAbortBlocks() {
+  /* exits are created inline with the blocks that branch to them,
+   * move them behind all region code so the hot blocks stay dense.
+   * the weights on the branches keep block placement from
+   * pulling them back in */
+  if(not(globals::branchWeights)) {
+    return;
+  }
+  for(llvm::BasicBlock *abortBB : abortBlocks) {
+    abortBB->moveAfter(&blockFunction->back());
+  }
+}
+
+void regionCFG::releaseIR() {
+  /* only codeBits, the engine backing it and what run() and
+   * report() look at survive codegen */
+  for(cfgBasicBlock *cbb : cfgBlocks) {
+    blockAddrs.push_back(cbb->getEntryAddr());
+    delete cbb;
+  }
+  std::vector<cfgBasicBlock*>().swap(cfgBlocks);
+  std::unordered_map<uint32_t, cfgBasicBlock*>().swap(cfgBlockMap);
+  cfgHead = entryBlock = innerPerfectBlock = nullptr;
+  arena.clear();
+  
+  for(size_t i = 0; i < 32; i++) {
+    gprDefinitionBlocks[i].clear();
+    fprDefinitionBlocks[i].clear();
+  }
+  for(size_t i = 0; i < 5; i++) {
+    fcrDefinitionBlocks[i].clear();
+  }
+  std::vector<std::vector<naturalLoop>>().swap(loopNesting);
+  std::vector<stackSlot>().swap(stackSlots);
+  std::vector<llvm::BasicBlock*>().swap(abortBlocks);
+  blockArgMap.clear();
+  builtinFuncts.clear();
+  tbaaGuestMem = tbaaGpr = tbaaIcnt = tbaaExit = nullptr;
+
+  delete myIRBuilder;
+  myIRBuilder = nullptr;
+  delete myEngineBuilder;
+  myEngineBuilder = nullptr;
+  /* mcjit keeps the loaded object and its memory manager,
+   * the module is no longer needed to run. a module for a
+   * shared object is gone already */
+  if(myModule) {
+    myExecEngine->removeModule(myModule);
+    delete myModule;
+    myModule = nullptr;
+  }
+  blockFunction = nullptr;
+  entryFunction = nullptr;
+}
+
+const std::string &regionCFG::hostCPU() {
+  static std::string cpu;
+  if(cpu.empty()) {
+    cpu = globals::hostCPU.empty() ?
+      llvm::sys::getHostCPUName().str() : globals::hostCPU;
+  }
+  return cpu;
+}
+
+const std::vector<std::string> &regionCFG::hostFeatures() {
+  /* +feature/-feature list, --hostFeatures replaces the
+   * detected set */
+  static std::vector<std::string> attrs;
+  static bool init = false;
+  if(not(init)) {
+    init = true;
+    if(not(globals::hostFeatures.empty())) {
+      std::stringstream ss(globals::hostFeatures);
+      std::string f;
+      while(std::getline(ss, f, ',')) {
+	if(not(f.empty())) {
+	  attrs.push_back(f);
+	}
+      }
+    }
+    else {
+      llvm::StringMap<bool> features;
+      if(llvm::sys::getHostCPUFeatures(features)) {
+	for(const auto &f : features) {
+	  attrs.push_back((f.getValue() ? "+" : "-") + f.getKey().str());
+	}
+	std::sort(attrs.begin(), attrs.end());
+      }
+    }
+  }
+  return attrs;
+}
+
+const std::string &regionCFG::hostTargetKey() {
+  static std::string key;
+  if(key.empty()) {
+    key = hostCPU();
+    for(const std::string &f : hostFeatures()) {
+      key += "," + f;
+    }
+  }
+  return key;
+}
+
+/* counts what mcjit maps for a region, the engine owns it */
+class countingMemoryManager : public llvm::SectionMemoryManager {
+private:
+  uint64_t &bytes;
+public:
+  countingMemoryManager(uint64_t &bytes) : bytes(bytes) {}
+  uint8_t *allocateCodeSection(uintptr_t sz, unsigned align, unsigned id,
+			       llvm::StringRef name) override {
+    bytes += sz;
+    return llvm::SectionMemoryManager::allocateCodeSection(sz, align, id, name);
+  }
+  uint8_t *allocateDataSection(uintptr_t sz, unsigned align, unsigned id,
+			       llvm::StringRef name, bool readOnly) override {
+    bytes += sz;
+    return llvm::SectionMemoryManager::allocateDataSection(sz, align, id, name, readOnly);
+  }
+};
+
+/* reads the line table of each object mcjit loads, rows hold the
+ * guest pc of the insn at a host address */
+class lineTableListener : public llvm::JITEventListener {
+  std::vector<std::pair<uint64_t, uint32_t>> &rows;
+public:
+  lineTableListener(std::vector<std::pair<uint64_t, uint32_t>> &rows) : rows(rows) {}
+  void notifyObjectLoaded(ObjectKey k, const llvm::object::ObjectFile &obj,
+			  const llvm::RuntimeDyld::LoadedObjectInfo &l) override {
+    llvm::object::OwningBinary<llvm::object::ObjectFile> dobj = l.getObjectForDebug(obj);
+    if(dobj.getBinary() == nullptr) {
+      return;
+    }
+    std::unique_ptr<llvm::DWARFContext> dwarf = llvm::DWARFContext::create(*dobj.getBinary());
+    for(const auto &cu : dwarf->compile_units()) {
+      const llvm::DWARFDebugLine::LineTable *lt = dwarf->getLineTableForUnit(cu.get());
+      if(lt == nullptr) {
+	continue;
+      }
+      for(const auto &row : lt->Rows) {
+	rows.emplace_back(row.Address.Address, row.EndSequence ? 0 : row.Line);
+      }
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+	return a.first < b.first;
+      });
+  }
+};
+
+bool regionCFG::guestPC(uint64_t host, uint32_t &pc) const {
+  auto it = std::upper_bound(hostPCs.begin(), hostPCs.end(), host,
+			     [](uint64_t h, const auto &r) {
+			       return h < r.first;
+			     });
+  if(it == hostPCs.begin() or (it-1)->second == 0) {
+    return false;
+  }
+  pc = (it-1)->second;
+  return true;
+}
+
+regionCFG *regionCFG::findByHostPC(uint64_t host) {
+  for(regionCFG *r : regionCFGs) {
+    uint32_t pc;
+    if(r->guestPC(host, pc)) {
+      return r;
+    }
+  }
+  return nullptr;
+}
+
+bool regionCFG::covers(uint32_t pc) const {
+  for(const basicBlock *bb : blocks) {
+    if(pc >= bb->getEntryAddr() and pc <= bb->getTermAddr()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void regionCFG::generateMachineCode( llvm::CodeGenOpt::Level optLevel){
+  if(sharedModule) {
+    /* aot::translate emits every region in one object */
+    if(llvm::Linker::linkModules(*sharedModule, std::unique_ptr<llvm::Module>(myModule))) {
+      die();
+    }
+    myModule = nullptr;
+    blockFunction = entryFunction = nullptr;
+    return;
+  }
   std::string errStr;
   myEngineBuilder = new llvm::EngineBuilder(std::unique_ptr<llvm::Module>(myModule));
+  myEngineBuilder->setMCJITMemoryManager(std::make_unique<countingMemoryManager>(codeBytes));
   myEngineBuilder->setOptLevel(optLevel);
   myEngineBuilder->setErrorStr(&errStr);
-#ifdef __amd64_
-  myEngineBuilder->setMCPU("corei7");
-#endif
+  myEngineBuilder->setMCPU(hostCPU());
+  myEngineBuilder->setMAttrs(hostFeatures());
   myExecEngine = myEngineBuilder->create();
 
 #ifdef USE_VTUNE
@@ -1452,16 +2478,120 @@ void regionCFG::generateMachineCode( llvm::CodeGenOpt::Level optLevel){
     llvm::JITEventListener::createIntelJITEventListener();
   myExecEngine->RegisterJITEventListener(vtuneProfiler);
 #endif
+  lineTableListener lines(hostPCs);
+  if(diSub) {
+    myExecEngine->RegisterJITEventListener(&lines);
+  }
   myExecEngine->finalizeObject();
-  codeBits = (compiledCFG)myExecEngine->getPointerToFunction(blockFunction);
+  if(diSub) {
+    myExecEngine->UnregisterJITEventListener(&lines);
+  }
+  codeBits = (compiledCFG)myExecEngine->getPointerToFunction(entryFunction);
+  if(globals::chainRegions) {
+    chainBody = myExecEngine->getPointerToFunction(blockFunction);
+  }
+  codeCacheBytes += codeBytes;
+  if(evictedHeads.erase(head->getEntryAddr())) {
+    recompiles++;
+  }
+  publish();
+}
+
+void regionCFG::publish() {
+  for(basicBlock *bb : osrBlocks) {
+    if(bb->osrCfg) {
+      bb->osrCfg->osrBlocks.erase(bb);
+    }
+    bb->osrCfg = this;
+  }
+  if(globals::chainRegions) {
+    chainSlot = &chainSlots[head->getEntryAddr()];
+    *chainSlot = chainBody;
+  }
+  lastRun = iters;
   std::string headname = "cfg_";
   if(perfectNest) {
     headname += "perfectNest_";
   }
-  headname += toStringHex(cfgHead->getEntryAddr());
+  headname += toStringHex(head->getEntryAddr());
   pmap->addEntry((uint64_t)codeBits, 1<<12, headname);
 }
 
+llvm::Value *regionCFG::hostAddr(llvm::IRBuilder<> &b, hostReloc kind, uint32_t key,
+				 const void *addr) {
+  if(sharedModule == nullptr) {
+    return llvm::ConstantInt::get(type_int64, reinterpret_cast<uint64_t>(addr));
+  }
+  auto k = std::make_pair(kind, key);
+  auto it = sharedRelocIds.find(k);
+  if(it == sharedRelocIds.end()) {
+    it = sharedRelocIds.emplace(k, sharedRelocs.size()).first;
+    sharedRelocs.push_back(k);
+  }
+  /* sized when aot::translate defines it, filled before any
+   * region runs and never written again */
+  llvm::ArrayType *tblTy = llvm::ArrayType::get(type_int64, 0);
+  llvm::GlobalVariable *tbl = myModule->getGlobalVariable(relocTable);
+  if(tbl == nullptr) {
+    tbl = new llvm::GlobalVariable(*myModule, tblTy, false,
+				   llvm::GlobalValue::ExternalLinkage,
+				   nullptr, relocTable);
+  }
+  llvm::Value *gep = b.CreateConstInBoundsGEP2_64(tblTy, tbl, 0, it->second);
+  llvm::LoadInst *ld = b.CreateLoad(type_int64, gep);
+  ld->setMetadata(llvm::LLVMContext::MD_invariant_load, llvm::MDNode::get(*Context, {}));
+  return ld;
+}
+
+void *regionCFG::relocTarget(hostReloc kind, uint32_t key) {
+  /* the body of a region the loader rejected is never published,
+   * nothing runs its counter updates */
+  static uint64_t unbound = 0;
+  switch(kind)
+    {
+    case hostReloc::bb:
+      return basicBlock::globalFindBlock(key);
+    case hostReloc::runs:
+    case hostReloc::lastRun: {
+      basicBlock *bb = basicBlock::globalFindBlock(key);
+      regionCFG *r = bb ? bb->cfgCplr : nullptr;
+      if(r == nullptr) {
+	return &unbound;
+      }
+      return kind == hostReloc::runs ? &r->runs : &r->lastRun;
+    }
+    case hostReloc::iters:
+      return &iters;
+    case hostReloc::chainSlot:
+      return &chainSlots[key];
+    case hostReloc::codeWritePending:
+      return const_cast<sig_atomic_t*>(&codeWritePending);
+    case hostReloc::hle:
+      return reinterpret_cast<void*>(&rv32_hle);
+    }
+  return nullptr;
+}
+
+void regionCFG::bindShared(basicBlock *h, const std::vector<basicBlock*> &path,
+			   const std::vector<basicBlock*> &osr, compiledCFG entry,
+			   void *body) {
+  /* the object's code stays mapped for good, it doesn't count
+   * against the code cache */
+  head = h;
+  blocks.insert(path.begin(), path.end());
+  for(basicBlock *bb : blocks) {
+    blockAddrs.push_back(bb->getEntryAddr());
+  }
+  osrBlocks.insert(osr.begin(), osr.end());
+  codeBits = entry;
+  chainBody = body;
+  compileTime = 0.0;
+  perfectNest = false;
+  h->cfgCplr = this;
+  h->hasRegion = true;
+  publish();
+}
+
 std::ostream &operator<<(std::ostream &out, const regionCFG &cfg) {
   std::vector<cfgBasicBlock*> topo;
   cfg.toposort(topo);
@@ -1942,6 +3072,10 @@ basicBlock* regionCFG::run(state_t *ss) {
   uint32_t abortpc = 0;
 
   uint32_t epc = ss->pc;
+  /* reading the counter costs about as much as a short region
+   * run, time one run in runTickSample */
+  bool timed = (runs % runTickSample) == 0;
+  uint64_t t0 = timed ? rdtsc() : 0;
   codeBits(
 	   &(ss->pc), 
 	   ss->gpr,
@@ -1951,6 +3085,11 @@ basicBlock* regionCFG::run(state_t *ss) {
 	   &nextbb,
 	   &abortpc
 	   );
+  if(timed) {
+    runTicks += (rdtsc() - t0) * runTickSample;
+  }
+  lastRun = iters;
+  globals::currUnit = nullptr;
 
   globals::cBB = reinterpret_cast<basicBlock*>(ss->abortloc);
 
@@ -1968,12 +3107,25 @@ basicBlock* regionCFG::run(state_t *ss) {
   minIcnt = std::min(minIcnt, i0);
   maxIcnt = std::max(maxIcnt, i0);
   runHistory[runs%histoLen] = i0;
-  runs++;
+  /* chained bodies count their own runs */
+  if(not(globals::chainRegions)) {
+    runs++;
+  }
   
   inscnt+=i0;
   icnt +=i0;
   iters++;
 
+  /* after a chain the exit may be another region's, only count
+   * exits of this region's blocks */
+  if(globals::growThresh and generation < maxGenerations and
+     ss->pc != head->getEntryAddr() and
+     blocks.find(globals::cBB) != blocks.end()) {
+    if(++exitCounts[ss->pc] == globals::growThresh) {
+      growTarget = ss->pc;
+    }
+  }
+
   if(ss->icnt >= globals::dumpicnt) {
     dumpState(*ss, globals::blobName);
     ss->brk = 1;
@@ -1994,6 +3146,7 @@ void regionCFG::dumpIR() {
    std::string o_name= "cfg_" + toStringHex(cfgHead->getEntryAddr()) + ".txt";
    std::ofstream o(o_name.c_str());
    o << *this;
+   doLiveAnalysis(o);
    o.close();
  }
  
@@ -2007,7 +3160,165 @@ void regionCFG::dumpLLVM() {
 }
 
 
-void regionCFG::runLLVMLoopAnalysis() {}
+/* --irPipeline presets, anything else is handed to the
+ * PassBuilder as a textual pipeline. bt targets what generateIR
+ * leaves behind : zext/gep/bitcast chains (instcombine), redundant
+ * guest and state accesses (gvn, dse, early-cse already ran) and
+ * the compare cascades of jr/jalr dispatch (simplifycfg) */
+static const std::map<std::string, std::string> irPipelinePresets = {
+  {"none", ""},
+  {"light", "function(instcombine,simplifycfg)"},
+  {"bt", "function(sroa,instcombine,simplifycfg,gvn,dse,"
+   "loop-mssa(licm),instcombine,simplifycfg)"},
+  {"O1", "default<O1>"},
+  {"O2", "default<O2>"},
+  {"O3", "default<O3>"},
+};
+
+/* --irPipeline, parsed once by initPasses. nullptr runs nothing */
+static llvm::ModulePassManager *irPasses = nullptr;
+
+static llvm::PassBuilder &irPassBuilder() {
+  static llvm::PassBuilder pb(getLoopTargetMachine());
+  return pb;
+}
+
+void regionCFG::runIRPipeline() {
+  if(irPasses == nullptr) {
+    return;
+  }
+  double t0 = timestamp();
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder &PB = irPassBuilder();
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  irPasses->run(*myModule, MAM);
+  optTime += timestamp() - t0;
+}
+
+void regionCFG::initPasses() {
+  /* indvars only rewrites "cheap" exit values by default,
+   * always rewrite so icnt leaves the loop body. set once
+   * here, llvm's options are process wide */
+  auto &opts = llvm::cl::getRegisteredOptions();
+  auto it = opts.find("replexitval");
+  if(it != opts.end()) {
+    it->second->addOccurrence(0, "replexitval", "always");
+  }
+
+  /* a bad pipeline stops the run here, before any region */
+  auto pit = irPipelinePresets.find(globals::irPipeline);
+  const std::string &pipeline = (pit == irPipelinePresets.end()) ?
+    globals::irPipeline : pit->second;
+  if(pipeline.empty()) {
+    return;
+  }
+  irPasses = new llvm::ModulePassManager();
+  if(llvm::Error err = irPassBuilder().parsePassPipeline(*irPasses, pipeline)) {
+    std::cerr << KRED << "bad ir pipeline \"" << pipeline << "\" : "
+	      << llvm::toString(std::move(err)) << KNRM << "\n";
+    die();
+  }
+}
+
+static llvm::MDNode *makeLoopID(llvm::LLVMContext &C, bool unroll) {
+  llvm::SmallVector<llvm::Metadata*, 4> md;
+  /* placeholder for self reference */
+  md.push_back(nullptr);
+  md.push_back(llvm::MDNode::get(C, {llvm::MDString::get(C, "llvm.loop.vectorize.enable"),
+	  llvm::ConstantAsMetadata::get(llvm::ConstantInt::getTrue(C))}));
+  if(unroll) {
+    md.push_back(llvm::MDNode::get(C, {llvm::MDString::get(C, "llvm.loop.unroll.enable")}));
+  }
+  llvm::MDNode *id = llvm::MDNode::getDistinct(C, md);
+  id->replaceOperandWith(0, id);
+  return id;
+}
+
+void regionCFG::runEarlyCSE() {
+  /* memoryssa based cse on every region, ahead of the loop passes
+   * and --irPipeline. forwards guest loads and stores across the
+   * state stores, see the tbaa tags in initLLVMAndGeneratePreamble */
+  double t0 = timestamp();
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB(getLoopTargetMachine());
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  llvm::FunctionPassManager FPM;
+  FPM.addPass(llvm::EarlyCSEPass(true));
+  FPM.run(*blockFunction, FAM);
+  optTime += timestamp() - t0;
+}
+
+void regionCFG::runLLVMLoopAnalysis() {
+  /* Feed the loop structure from findNaturalLoops to llvm.
+   * Innermost loops of a perfect nest get vectorize (and, when small, 
+   * unroll) hints on their latches. Preheaders are created by 
+   * loop-simplify, guest loads are hoisted by licm and indvars 
+   * rewrites the icnt value at the exits as a trip-count multiply */
+  static const size_t maxUnrollInsns = 64;
+  llvm::TargetMachine *tm = getLoopTargetMachine();
+  llvm::DominatorTree DT(*blockFunction);
+  llvm::LoopInfo LI(DT);
+  size_t nHinted = 0;
+  
+  if(perfectNest and not(loopNesting.empty())) {
+    for(const naturalLoop &nl : loopNesting.back()) {
+      llvm::BasicBlock *hBB = nl.getHead()->lBB;
+      llvm::Loop *L = LI.getLoopFor(hBB);
+      if(L == nullptr or L->getHeader() != hBB or not(L->isInnermost())) {
+	continue;
+      }
+      size_t nInsns = 0;
+      for(cfgBasicBlock *cbb : nl.getLoop()) {
+	nInsns += cbb->rawInsns.size();
+      }
+      L->setLoopID(makeLoopID(*Context, nInsns <= maxUnrollInsns));
+      nHinted++;
+    }
+  }
+
+  int optLevel = static_cast<int>(globals::regionOptLevel);
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB(tm);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::FunctionPassManager FPM;
+  llvm::LoopPassManager LPM;
+  FPM.addPass(llvm::LoopSimplifyPass());
+  FPM.addPass(llvm::LCSSAPass());
+  LPM.addPass(llvm::LICMPass());
+  LPM.addPass(llvm::IndVarSimplifyPass());
+  FPM.addPass(llvm::createFunctionToLoopPassAdaptor(std::move(LPM), true));
+  if(nHinted) {
+    llvm::LoopVectorizeOptions vopts;
+    vopts.setVectorizeOnlyWhenForced(true);
+    FPM.addPass(llvm::LoopVectorizePass(vopts));
+    FPM.addPass(llvm::LoopUnrollPass(llvm::LoopUnrollOptions(optLevel, true)));
+  }
+  FPM.addPass(llvm::InstCombinePass());
+  FPM.addPass(llvm::SimplifyCFGPass());
+  FPM.run(*blockFunction, FAM);
+}
 
 
 void regionCFG::findLoop(std::set<cfgBasicBlock*> &loop, 
@@ -2018,7 +3329,7 @@ void regionCFG::findLoop(std::set<cfgBasicBlock*> &loop,
     stack.pop_front();
     loop.insert(c);
     if(c != hbb) {
-      for(std::set<cfgBasicBlock*>::iterator sit = c->preds.begin(); sit != c->preds.end(); sit++) {
+      for(auto sit = c->preds.begin(); sit != c->preds.end(); sit++) {
 	cfgBasicBlock *cc = *sit;
 	if(loop.find(cc) == loop.end()) {	
 	  stack.push_front(cc);
@@ -2156,20 +3467,24 @@ void regionCFG::report(std::string &s, uint64_t icnt) {
      << ",nextpcs = " << nextPCs.size()
      << ",static icnt = " << countInsns()
      << ",compile time = " << compileTime
+     << ",run time = " << (ticksPerSec > 0.0 ? runTicks / ticksPerSec : 0.0)
      << ",frac=" << frac << ")\n";
   s += ss.str();
 #if 1
-  if(frac > 0.10) {
+  if(frac > 0.10 and myModule) {
     dumpIR();
     dumpLLVM();
     asDot();
   }
 #endif
+  std::vector<uint32_t> addrs(blockAddrs);
   for(const auto & blk : cfgBlocks) {
-    uint32_t x = blk->getEntryAddr();
+    addrs.push_back(blk->getEntryAddr());
+  }
+  for(uint32_t x : addrs) {
     if(x != ~(0U)) {
       s += toStringHex(x) + ",";
-      debugSymDB::lookup(blk->getEntryAddr(),s);
+      debugSymDB::lookup(x,s);
     }
   }
   s += "\n\n";
@@ -2228,6 +3543,10 @@ void regionCFG::toposort(std::vector<cfgBasicBlock*> &topo) const {
     }
     topo.push_back(bb);
   };
+  if(entryBlock == nullptr) {
+    /* cfg already released */
+    return;
+  }
   dfs(entryBlock);
   std::reverse(topo.begin(), topo.end());
 }
@@ -2280,7 +3599,7 @@ void regionCFG::splitBBs() {
 	  if(needSplit) {
 	    
 	    cfgBasicBlock *sbb = zbb->splitBB(splitPoint);
-	    cfgBlocks.push_back(sbb);
+	    addCfgBlock(sbb);
 	    /*
 	    std::cerr << std::hex << "adding edge from "
 		      << bb->getEntryAddr()
@@ -2305,12 +3624,54 @@ void regionCFG::splitBBs() {
 }
 
 void regionCFG::doLiveAnalysis(std::ostream &out) const {
-  
-  //for(const cfgBasicBlock *BB : cfgBlocks) {
-  //    for(const Insn *I : BB->getInsns()) {
-  //
-  //}
-  //}
-    
-  //
+  /* backwards liveness, block reads are treated as upward exposed.
+   * every gpr is live out of a block that can leave the region */
+  std::map<const cfgBasicBlock*, std::bitset<32>> defs, liveIn;
+  for(size_t gpr = 1; gpr < 32; gpr++) {
+    for(cfgBasicBlock *cbb : gprDefinitionBlocks[gpr]) {
+      if(cbb != entryBlock) {
+	defs[cbb][gpr] = true;
+      }
+    }
+  }
+  std::vector<cfgBasicBlock*> topo;
+  toposort(topo);
+  std::reverse(topo.begin(), topo.end());
+  auto exits = [](const cfgBasicBlock *cbb) {
+    return cbb->bb and (cbb->bb->hasJR() or cbb->bb->hasJALR() or
+			(cbb->bb->getSuccs().size() != cbb->succs.size()));
+  };
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(const cfgBasicBlock *cbb : topo) {
+      std::bitset<32> lo;
+      if(exits(cbb)) {
+	lo.set();
+      }
+      for(const cfgBasicBlock *sbb : cbb->succs) {
+	lo |= liveIn[sbb];
+      }
+      std::bitset<32> li = cbb->gprRead | (lo & ~defs[cbb]);
+      if(li != liveIn[cbb]) {
+	liveIn[cbb] = li;
+	changed = true;
+      }
+    }
+  }
+  for(const cfgBasicBlock *cbb : topo) {
+    if(cbb == entryBlock) {
+      continue;
+    }
+    out << "block 0x" << std::hex << cbb->getEntryAddr() << std::dec
+	<< (exits(cbb) ? " (exit)" : "") << "\n\tlive in :";
+    for(size_t gpr = 1; gpr < 32; gpr++) {
+      if(liveIn[cbb][gpr]) out << " " << getGPRName(gpr);
+    }
+    out << "\n\tmodified :";
+    for(size_t gpr = 1; gpr < 32; gpr++) {
+      if(cbb->gprModified[gpr]) out << " " << getGPRName(gpr);
+    }
+    out << "\n";
+  }
 }
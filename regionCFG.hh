@@ -14,6 +14,7 @@
 #include "execUnit.hh"
 #include "basicBlock.hh"
 #include "ssaInsn.hh"
+#include "regionArena.hh"
 #include "riscvInstruction.hh"
 #include "llvmInc.hh"
 #include "perfmap.hh"
@@ -24,6 +25,9 @@ class Insn;
 class cfgBasicBlock;
 class llvmRegTables;
 
+/* cfg edges, nearly every block has one or two */
+typedef llvm::SmallSetVector<cfgBasicBlock*, 4> cfgEdgeList;
+
 #define __fpr_state_list(m) \
   m(unused) \
   m(singlePrec) \
@@ -45,6 +49,17 @@ inline std::ostream &operator<<(std::ostream &out, const fprUseEnum &fprState) {
 }
 #undef __fpr_state_list
 
+/* host addresses compiled code uses, see regionCFG::hostAddr */
+enum class hostReloc : uint32_t {
+  bb,			/* basicBlock at a guest pc, stored to abortloc */
+  runs,			/* run counters of the region at a head pc */
+  lastRun,
+  iters,
+  chainSlot,		/* chainSlots entry of a guest pc */
+  codeWritePending,
+  hle			/* rv32_hle */
+};
+
 typedef void (*compiledCFG)
 (
  uint32_t*, /* pc */
@@ -130,8 +145,13 @@ class fcrPhiNode : public phiNode {
 };
 
 class icntPhiNode : public phiNode {
+protected:
+  cfgBasicBlock *blk = nullptr;
 public:
   icntPhiNode(uint32_t id=0) : phiNode(insnDefType::icnt) {}
+  void setBlock(cfgBasicBlock *b) {
+    blk = b;
+  }
   void makeLLVMPhi(regionCFG *cfg, llvmRegTables& regTbl) override;
   void addIncomingEdge(regionCFG *cfg, cfgBasicBlock *b) override;
   void print() const override {
@@ -139,13 +159,40 @@ public:
   }
 };
 
+/* known guest memory contents at [root + disp, root + disp + width),
+ * root is a register value with constant adds stripped (nullptr for
+ * absolute addresses). st is the store that produced the value while
+ * it can still be dropped by a later store to the same bytes */
+struct guestMemVal {
+  llvm::Value *root;
+  uint32_t disp;
+  uint32_t width;
+  llvm::Value *v;
+  llvm::StoreInst *st;
+  bool fromStore;
+};
+
+/* a word at a fixed offset from the region entry sp that lives in
+ * an alloca (ssa after mem2reg) instead of guest memory, it is
+ * written back at exits and around accesses that may alias it */
+struct stackSlot {
+  int32_t offs;
+  bool stored;
+  llvm::AllocaInst *val;
+  llvm::Value *ptr;
+};
+
 class llvmRegTables : public MipsRegTable<llvm::Value> {
 public:
   regionCFG *cfg = nullptr;
   llvm::IRBuilder<> *myIRBuilder = nullptr;
   llvm::Value *iCnt = nullptr;
+  std::vector<guestMemVal> memTbl;
+  /* promoted stack slot accessed by the insn being generated */
+  int32_t curSlot = -1;
+  std::vector<bool> slotDirty;
   void initIcnt(); 
-  void incrIcnt(size_t amt); 
+  void incrIcnt(int64_t amt); 
   llvmRegTables(regionCFG *cfg);
   llvmRegTables();
   llvm::Value *loadGPR(uint32_t gpr);
@@ -158,6 +205,9 @@ public:
   void storeFPR(uint32_t fpr);
   void storeFCR(uint32_t fcr);
   void storeIcnt();
+  llvm::Value *loadMem(uint32_t rs1, int32_t disp, llvm::Type *ty,
+		       const std::string &name);
+  void storeMem(uint32_t rs1, int32_t disp, llvm::Value *v);
   llvm::Value *getIcnt() {
     return iCnt;
   }
@@ -180,7 +230,7 @@ class cfgBasicBlock {
   llvmRegTables termRegTbl;
   llvm::BasicBlock *lBB;
   cfgBasicBlock *idombb;
-  std::set<cfgBasicBlock*> dtree_succs;
+  cfgEdgeList dtree_succs;
 
   std::vector<phiNode*> phiNodes;
   std::array<phiNode*,32> gprPhis;
@@ -190,9 +240,9 @@ class cfgBasicBlock {
 
   std::map<llvm::BasicBlock*, llvm::BasicBlock*> jrMap;
 
-  std::set<cfgBasicBlock*> preds;
-  std::set<cfgBasicBlock*> succs;
-  std::set<cfgBasicBlock*> dfrontier;
+  cfgEdgeList preds;
+  cfgEdgeList succs;
+  std::vector<cfgBasicBlock*> dfrontier;
   std::vector<basicBlock::insPair> rawInsns;
   std::vector<Insn*> insns;
   std::vector<ssaInsn*> ssaInsns;
@@ -204,8 +254,20 @@ class cfgBasicBlock {
 
   std::vector<fprUseEnum> fprTouched;
   
+  /* dense index into regionCFG::cfgBlocks */
+  uint32_t blockId = 0;
+  /* dfs number from the dominator computation */
+  int32_t cfgId = 0;
   ssize_t dt_dfn = -1;
   ssize_t dt_max_ancestor_dfn = -1;
+  /* deferred icnt : potential of this block, edge
+   * increments are |succ| + potential - succ potential */
+  int64_t icntPotential = 0;
+  /* gprs written on some path from region entry to the end of
+   * this block, exits only write back these */
+  std::bitset<32> gprModified;
+  /* per insn index into regionCFG::stackSlots, or -1 */
+  std::vector<int32_t> stackSlotOf;
 
   
   llvm::BasicBlock *getSuccLLVMBasicBlock(uint32_t pc);
@@ -238,17 +300,23 @@ class cfgBasicBlock {
   void delSuccessor(cfgBasicBlock *s);
   cfgBasicBlock(basicBlock *bb);
   ~cfgBasicBlock();
+  static void *operator new(size_t sz) {
+    return regionArena::allocate(sz);
+  }
+  static void operator delete(void *p) {
+    regionArena::release(p);
+  }
   void updateFPRTouched(uint32_t reg, fprUseEnum useType);
-  const std::set<cfgBasicBlock*> &getPreds() const {
+  const cfgEdgeList &getPreds() const {
     return preds;
   }
   size_t numSuccessors() const {
     return succs.size();
   }
-  const std::set<cfgBasicBlock*> &getSuccs() const {
+  const cfgEdgeList &getSuccs() const {
     return succs;
   }
-  const std::set<cfgBasicBlock*> &getDTSuccs() const {
+  const cfgEdgeList &getDTSuccs() const {
     return dtree_succs;
   }
   const std::vector<Insn*> &getInsns() const {
@@ -272,6 +340,21 @@ class cfgBasicBlock {
   void addDTreeSucc(cfgBasicBlock *bb) {
     dtree_succs.insert(bb);
   }
+  double execFreq() const {
+    return bb ? static_cast<double>(bb->getTotalEdges()) : 0.0;
+  }
+  double edgeFreq(const cfgBasicBlock *succ) const;
+  /* profiled count of the edge out of this block to pc */
+  uint64_t succCount(uint32_t pc) const {
+    return bb ? bb->edgeCount(pc) : 0;
+  }
+  std::vector<cfgBasicBlock*> succsByFreq() const;
+  int64_t icntEdgeIncr(const cfgBasicBlock *succ) const {
+    return static_cast<int64_t>(succ->insns.size()) + icntPotential - succ->icntPotential;
+  }
+  int64_t icntExitIncr() const {
+    return icntPotential;
+  }
   bool fastDominates(const cfgBasicBlock *B) const {
     /* Appel exercise 19.1 - constant time dominance */
     return  (this==B) || ((dt_dfn  < B->dt_dfn) && (dt_max_ancestor_dfn >= B->dt_dfn));
@@ -310,6 +393,9 @@ public:
   const std::set<cfgBasicBlock*> &getLoop() const {
     return loop;
   }
+  cfgBasicBlock *getHead() const {
+    return head;
+  }
 };
 
 class sortNaturalLoops {
@@ -338,12 +424,78 @@ protected:
   bool hasBoth = false;
   bool validDominanceAcceleration = false;
   double compileTime = 0.0;
+  /* rdtsc ticks spent in compiled code, estimated from one run
+   * in runTickSample */
+  uint64_t runTicks = 0;
+  const static uint64_t runTickSample = 64;
+  /* value of iters at the last run, recency for eviction */
+  uint64_t lastRun = 0;
+  /* rebuilds (growth or fusion) that led to this region */
+  uint32_t generation = 0;
+  const static uint32_t maxGenerations = 8;
+  /* runs that left the region at each pc, and the pc that
+   * crossed globals::growThresh */
+  std::unordered_map<uint32_t, uint64_t> exitCounts;
+  uint32_t growTarget = 0;
+  /* bytes of code and data mcjit mapped for this region */
+  uint64_t codeBytes = 0;
+  /* chained entry point and the chainSlots entry it was
+   * published in, unpublished again when the region goes */
+  void *chainBody = nullptr;
+  void **chainSlot = nullptr;
+  /* entry pcs of the cfg blocks, kept for report() once
+   * the cfg is released */
+  std::vector<uint32_t> blockAddrs;
+  /* backs cfgBlocks, their phis and insns */
+  regionArena arena;
+  /* line table of the loaded code with memGuard on : host address
+   * and the guest pc of the insn there (0 past the end of a
+   * sequence), sorted by host address */
+  std::vector<std::pair<uint64_t, uint32_t>> hostPCs;
   
  public:
   friend std::ostream &operator<<(std::ostream &out, const regionCFG &cfg);
   static uint64_t icnt;
   static uint64_t iters;
+  static uint64_t exitStores;
+  static uint64_t exitStoresElided;
+  static uint64_t memLoadsForwarded;
+  static uint64_t memLoadsReused;
+  static uint64_t memStoresElided;
+  static uint64_t stackSlotsPromoted;
+  static uint64_t stackOpsPromoted;
+  static uint64_t stackOpsMaterialized;
+  static double domTime;
+  static double buildTime;
+  static double optTime;
+  static uint64_t hleCallsEmitted;
+  static uint64_t regionsBuilt;
+  static uint64_t arenaBytes;
+  static double ticksPerSec;
+  static uint64_t codeCacheBytes;
+  static uint64_t evictions;
+  static uint64_t recompiles;
+  static std::set<uint32_t> evictedHeads;
+  static uint64_t chainExitsEmitted;
+  static uint64_t osrEntriesEmitted;
+  static uint64_t osrRuns;
+  static uint64_t regionsGrown;
+  /* region head pc -> ghccc body of the compiled region, nullptr
+   * while there is none. map nodes never move so exits bake in
+   * the slot address */
+  static std::unordered_map<uint32_t, void*> chainSlots;
+  /* guest registers passed in host registers between chained regions */
+  static const uint32_t chainGprs[];
+  static const size_t numChainGprs;
   static std::set<regionCFG*> regionCFGs;
+  /* set while aot::translate compiles regions into one module for
+   * a shared object. code then loads every host address from the
+   * table named relocTable, entry i is sharedRelocs[i] and is
+   * filled in by aot::load */
+  static llvm::Module *sharedModule;
+  static std::vector<std::pair<hostReloc, uint32_t>> sharedRelocs;
+  static std::map<std::pair<hostReloc, uint32_t>, uint32_t> sharedRelocIds;
+  static const char *const relocTable;
   std::unordered_map<std::string, llvm::Function*> builtinFuncts;
 
   void doLiveAnalysis(std::ostream &out) const;
@@ -361,11 +513,21 @@ protected:
   std::array<uint64_t, histoLen> runHistory;
   std::set<uint32_t> nextPCs;
   std::set<basicBlock*> blocks;
+  /* blocks that enter this region at their own pc (basicBlock::osrCfg) */
+  std::set<basicBlock*> osrBlocks;
   compiledCFG codeBits;
   perfmap *pmap;
   llvm::LLVMContext *Context;
   std::map<std::string, llvm::Value*> blockArgMap;
   llvm::Function *blockFunction;
+  /* blockFunction's debug scope, insns carry their pc as line */
+  llvm::DISubprogram *diSub;
+  /* C abi entry called by run(), blockFunction itself unless regions
+   * are chained, then a wrapper around the ghccc body */
+  llvm::Function *entryFunction;
+  llvm::FunctionType *chainFunctionType;
+  /* chained entry : guest registers arriving as arguments */
+  std::array<llvm::Value*, 32> gprArgs;
   llvm::IRBuilder<> *myIRBuilder;
   llvm::Module *myModule;
   llvm::EngineBuilder *myEngineBuilder; 
@@ -374,6 +536,17 @@ protected:
   llvm::Type *type_iPtr64,*type_void;
   llvm::Type *type_float, *type_double;
   llvm::Type *type_int32, *type_int64;
+  /* tbaa access tags : guest memory, register file, icnt and the
+   * exit slots (pc, abortloc, nextbb, abortpc) never alias */
+  llvm::MDNode *tbaaGuestMem, *tbaaGpr, *tbaaIcnt, *tbaaExit;
+  void setTBAA(llvm::Value *v, llvm::MDNode *tag) const {
+    llvm::cast<llvm::Instruction>(v)->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+  }
+  /* !prof weights from profiled edge counts, nullptr without a profile */
+  llvm::MDNode *branchWeights(uint64_t t, uint64_t nt) const;
+  /* exit stubs, moved behind the hot blocks once codegen is done */
+  std::vector<llvm::BasicBlock*> abortBlocks;
+  void sinkAbortBlocks();
  
   std::set<cfgBasicBlock*> gprDefinitionBlocks[32];
   std::set<cfgBasicBlock*> fprDefinitionBlocks[32];
@@ -383,23 +556,43 @@ protected:
   std::bitset<32> allFprRead;
   std::bitset<5> allFcrRead;
   std::vector<fprUseEnum> allFprTouched;
+  std::vector<stackSlot> stackSlots;
 
 
   std::vector< std::vector<naturalLoop> >loopNesting;
 
 
   std::vector<cfgBasicBlock*> cfgBlocks;
-  std::map<uint32_t, cfgBasicBlock*> cfgBlockMap;
+  std::unordered_map<uint32_t, cfgBasicBlock*> cfgBlockMap;
+  void addCfgBlock(cfgBasicBlock *cbb) {
+    cbb->blockId = cfgBlocks.size();
+    cfgBlocks.push_back(cbb);
+  }
 
   void splitBBs();
   bool allBlocksReachable(cfgBasicBlock *root);
-  void computeDominance();
   void computeDominanceFrontiers();
   void computeLengauerTarjanDominance();
+  void computeIcntPotentials();
+  void addOSREntries();
+  void computeModifiedRegs();
+  void findStackSlots();
+  void initStackSlots(llvmRegTables &regTbl);
+  void writebackStackSlots(std::vector<bool> &dirty);
+  void reloadStackSlots(llvmRegTables &regTbl);
+  /* the i64 host address of key's kind, a constant in jit code */
+  llvm::Value *hostAddr(llvm::IRBuilder<> &b, hostReloc kind, uint32_t key,
+			const void *addr);
+  /* true when the host ran the call */
+  llvm::Value *emitHLECall(int32_t fn, llvmRegTables &regTbl);
   void fastDominancePreComputation();
   void insertPhis();
   void getRegDefBlocks();
   void initLLVMAndGeneratePreamble();
+  void generateChainPreamble(const std::string &name,
+			     llvm::FunctionType *entryType,
+			     const std::vector<std::string> &argNames);
+  void generateChainExit(uint32_t target, llvmRegTables &regTbl);
   llvm::BasicBlock* generateAbortBasicBlock(uint32_t abortpc,
 					    llvmRegTables& regTbl, 
 					    cfgBasicBlock *cBB,
@@ -416,7 +609,19 @@ protected:
 
   bool analyzeGraph();
   void generateMachineCode( llvm::CodeGenOpt::Level optLevel);
+  /* makes loaded code run : side entries, chain slot, perf map */
+  void publish();
+  /* region at h running code from a shared object */
+  void bindShared(basicBlock *h, const std::vector<basicBlock*> &path,
+		  const std::vector<basicBlock*> &osr, compiledCFG entry,
+		  void *body);
+  /* what a sharedRelocs entry points at in this process, nullptr
+   * when there is no such block */
+  static void *relocTarget(hostReloc kind, uint32_t key);
+  void releaseIR();
   void runLLVMLoopAnalysis();
+  void runEarlyCSE();
+  void runIRPipeline();
   void dumpLLVM();
   void dumpIR();
   void emulate(state_t *s);
@@ -428,6 +633,27 @@ protected:
   void findNaturalLoops();
   bool dominates(cfgBasicBlock *A, cfgBasicBlock *B) const;
   static void dropCompiled();
+  static void dropRegionsWith(const std::set<basicBlock*> &bbs);
+  static void evictColdRegions(const regionCFG *keep);
+  /* rebuild r to cover its hot exit, returns the head's region */
+  static regionCFG *grow(regionCFG *r);
+  /* merge r with a region sharing most of its blocks, returns
+   * the region now holding r's blocks */
+  static regionCFG *fuse(regionCFG *r);
+  /* guest pc of the insn compiled at host address host */
+  bool guestPC(uint64_t host, uint32_t &pc) const;
+  static regionCFG *findByHostPC(uint64_t host);
+  bool covers(uint32_t pc) const;
+  bool growthPending() const {
+    return growTarget != 0;
+  }
+  /* jit target, detected unless overridden on the command line */
+  static const std::string &hostCPU();
+  static const std::vector<std::string> &hostFeatures();
+  /* cpu and feature string, part of the key of any cached code */
+  static const std::string &hostTargetKey();
+  /* llvm option and pass setup, once before the first region */
+  static void initPasses();
   uint32_t getEntryAddr() const override;
   basicBlock* run(state_t *s) override;
   void report(std::string &s, uint64_t icnt) override;
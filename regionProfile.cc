@@ -0,0 +1,224 @@
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "regionProfile.hh"
+#include "regionCFG.hh"
+#include "basicBlock.hh"
+#include "helper.hh"
+#include "globals.hh"
+
+uint64_t regionProfile::regionsLoaded = 0;
+uint64_t regionProfile::regionsRejected = 0;
+
+static uint32_t insnCrc(uint8_t *mem, uint32_t entry, uint32_t term) {
+  return crc32(mem + entry, (term - entry) + 4);
+}
+
+void regionProfile::save(const std::string &fname) {
+  std::ofstream out(fname);
+  if(not(out.is_open())) {
+    std::cerr << "can't write region profile " << fname << "\n";
+    return;
+  }
+  save(out);
+}
+
+void regionProfile::save(std::ostream &out) {
+  std::set<basicBlock*> bbs;
+  for(const regionCFG *r : regionCFG::regionCFGs) {
+    bbs.insert(r->blocks.begin(), r->blocks.end());
+  }
+  out << "rv32-regions " << version << "\n" << std::hex;
+  /* bb entry term crc inscnt totalEdges nEdges {pc cnt}* */
+  for(basicBlock *bb : bbs) {
+    if(not(bb->readOnly) or bb->vecIns.empty()) {
+      continue;
+    }
+    uint32_t term = bb->vecIns.back().second;
+    std::vector<uint32_t> words;
+    for(const auto &p : bb->vecIns) {
+      words.push_back(p.first);
+    }
+    out << "bb " << bb->entryAddr << " " << term << " "
+	<< crc32(reinterpret_cast<uint8_t*>(words.data()), 4*words.size()) << " "
+	<< bb->inscnt << " " << bb->totalEdges << " "
+	<< bb->edgeCnts.size();
+    for(const auto &e : bb->edgeCnts) {
+      out << " " << e.first << " " << e.second;
+    }
+    out << "\n";
+  }
+  /* region head nBlocks {pc}* */
+  for(const regionCFG *r : regionCFG::regionCFGs) {
+    out << "region " << r->getEntryAddr() << " " << r->blocks.size();
+    for(const basicBlock *bb : r->blocks) {
+      out << " " << bb->getEntryAddr();
+    }
+    out << "\n";
+  }
+}
+
+void regionProfile::load(const std::string &fname, state_t *s) {
+  std::ifstream in(fname);
+  if(not(in.is_open())) {
+    std::cerr << "can't read region profile " << fname << "\n";
+    return;
+  }
+  read(in, fname, s, [](basicBlock *head, std::vector<basicBlock*> &path) {
+      head->bbRegions.push_back(path);
+      return head->compileRegions();
+    }, regionsLoaded, regionsRejected);
+}
+
+void regionProfile::read(std::istream &in, const std::string &fname, state_t *s,
+			 const installFn &install, uint64_t &loaded,
+			 uint64_t &rejected) {
+  std::string tag;
+  uint32_t v = 0;
+  in >> tag >> v >> std::hex;
+  if(tag != "rv32-regions" or v != version) {
+    std::cerr << fname << " isn't a region profile\n";
+    return;
+  }
+  std::map<uint32_t, basicBlock*> rebuilt;
+  std::map<basicBlock*, std::map<uint32_t, uint64_t>> edges;
+  std::vector<std::pair<uint32_t, std::vector<uint32_t>>> regions;
+  uint64_t bbRecords = 0;
+  bool corrupt = false;
+  while(in >> tag) {
+    if(tag == "bb") {
+      uint32_t entry = 0, term = 0, crc = 0;
+      uint64_t inscnt = 0, totalEdges = 0, nEdges = 0;
+      in >> entry >> term >> crc >> inscnt >> totalEdges >> nEdges;
+      if(not(in) or nEdges > maxEdges) {
+	corrupt = true;
+	break;
+      }
+      std::map<uint32_t, uint64_t> e;
+      for(uint64_t i = 0; in and i < nEdges; i++) {
+	uint32_t pc = 0;
+	uint64_t cnt = 0;
+	in >> pc >> cnt;
+	e[pc] = cnt;
+      }
+      if(not(in)) {
+	corrupt = true;
+	break;
+      }
+      bbRecords++;
+      /* the binary or what it wrote into its text since */
+      if(term < entry or (entry & 3) or
+	 insnCrc(s->mem, entry, term) != crc or
+	 basicBlock::globalFindBlock(entry) != nullptr) {
+	continue;
+      }
+      basicBlock *bb = new basicBlock(entry);
+      for(uint32_t pc = entry; pc <= term; pc += 4) {
+	bb->addIns(*reinterpret_cast<uint32_t*>(s->mem + pc), pc);
+      }
+      bb->setTermAddr(term);
+      bb->setReadOnly();
+      bb->inscnt = inscnt;
+      bb->totalEdges = totalEdges;
+      bb->edgeCnts = e;
+      rebuilt[entry] = bb;
+      edges[bb] = e;
+    }
+    else if(tag == "region") {
+      uint32_t head = 0;
+      uint64_t n = 0;
+      in >> head >> n;
+      /* save writes a bb record for every block of every region */
+      if(not(in) or n > bbRecords) {
+	corrupt = true;
+	break;
+      }
+      std::vector<uint32_t> pcs(n);
+      for(uint64_t i = 0; in and i < n; i++) {
+	in >> pcs[i];
+      }
+      if(not(in)) {
+	corrupt = true;
+	break;
+      }
+      regions.emplace_back(head, pcs);
+    }
+    else {
+      std::cerr << fname << " : unknown record " << tag << "\n";
+      return;
+    }
+  }
+  /* what came before the bad record still loads */
+  if(corrupt) {
+    std::cerr << fname << " : truncated or corrupt after "
+	      << std::dec << bbRecords << " blocks and "
+	      << regions.size() << " regions\n";
+  }
+
+  /* successor edges between rebuilt blocks, everything else is
+   * found the usual way once the guest runs */
+  for(auto &p : edges) {
+    basicBlock *bb = p.first;
+    for(const auto &e : p.second) {
+      auto it = rebuilt.find(e.first);
+      if(it == rebuilt.end()) {
+	continue;
+      }
+      if(bb->fallsThru() and not(bb->succs.empty())) {
+	continue;
+      }
+      if(bb->succs.size() >= 2 and not(bb->hasjr or bb->hasjalr or bb->hasmonitor)) {
+	continue;
+      }
+      bb->addSuccessor(it->second);
+    }
+  }
+
+  for(const auto &r : regions) {
+    auto hit = rebuilt.find(r.first);
+    if(hit == rebuilt.end()) {
+      rejected++;
+      continue;
+    }
+    basicBlock *head = hit->second;
+    std::vector<basicBlock*> path = {head};
+    bool complete = true;
+    for(uint32_t pc : r.second) {
+      auto it = rebuilt.find(pc);
+      if(it == rebuilt.end()) {
+	complete = false;
+	break;
+      }
+      if(it->second != head) {
+	path.push_back(it->second);
+      }
+    }
+    /* buildCFG insists on every block being reachable from the head */
+    std::set<basicBlock*> within(path.begin(), path.end()), seen = {head};
+    std::vector<basicBlock*> work = {head};
+    while(complete and not(work.empty())) {
+      basicBlock *bb = work.back();
+      work.pop_back();
+      for(basicBlock *nbb : bb->succs) {
+	if(within.count(nbb) and seen.insert(nbb).second) {
+	  work.push_back(nbb);
+	}
+      }
+    }
+    if(not(complete) or head->hasRegion or seen.size() != within.size()) {
+      rejected++;
+      continue;
+    }
+    for(basicBlock *bb : path) {
+      bb->cfgInRegions.insert(head);
+    }
+    if(install(head, path)) {
+      loaded++;
+    }
+    else {
+      rejected++;
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef __REGIONPROFILE_HH__
+#define __REGIONPROFILE_HH__
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct state_t;
+class basicBlock;
+
+/* region profiles : save writes the compiled regions of this run
+ * (heads, block extents, edge counts and a crc of each block's
+ * insns) to a text file. load rebuilds those blocks from guest
+ * memory at startup and compiles the regions before dispatch
+ * starts, so a later run of the same binary doesn't have to find
+ * them again. blocks whose insns no longer match are dropped
+ * along with the regions using them */
+class regionProfile {
+private:
+  static const uint32_t version = 1;
+  /* distinct successors a block can record, jr and jalr blocks
+   * included. anything larger is a corrupt file */
+  static const uint64_t maxEdges = 1UL<<16;
+public:
+  /* gets a region whose blocks all rebuilt, head first, and
+   * returns false to reject it */
+  typedef std::function<bool(basicBlock*, std::vector<basicBlock*>&)> installFn;
+  static uint64_t regionsLoaded;
+  static uint64_t regionsRejected;
+  static void save(std::ostream &out);
+  static void save(const std::string &fname);
+  static void load(const std::string &fname, state_t *s);
+  /* rebuilds the blocks of a profile named name and installs its
+   * regions, load compiles them */
+  static void read(std::istream &in, const std::string &name, state_t *s,
+		   const installFn &install, uint64_t &loaded,
+		   uint64_t &rejected);
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <unordered_set>
+
+#include "regionSched.hh"
+#include "basicBlock.hh"
+#include "helper.hh"
+#define ELIDE_LLVM
+#include "globals.hh"
+
+std::unordered_map<basicBlock*, regionSched::pending_t> regionSched::pending;
+std::vector<std::pair<double, basicBlock*>> regionSched::heap;
+double regionSched::credit = 0.0;
+double regionSched::lastRefill = 0.0;
+double regionSched::compileSecs = 0.0;
+uint64_t regionSched::compiledInsns = 0;
+uint32_t regionSched::pollCnt = 0;
+uint64_t regionSched::deferred = 0;
+uint64_t regionSched::dropped = 0;
+
+/* rough interpreter cost of a guest insn over its cost in a region */
+static const double interpSecsSavedPerInsn = 10e-9;
+/* compile cost guess until the first regions have been timed */
+static const double defaultCompileSecsPerInsn = 50e-6;
+
+double regionSched::compileSecsPerInsn() {
+  if(compiledInsns == 0) {
+    return defaultCompileSecsPerInsn;
+  }
+  return compileSecs / compiledInsns;
+}
+
+void regionSched::refill() {
+  double now = timestamp();
+  double rate = globals::compileBudget * 1e-3;
+  if(lastRefill == 0.0) {
+    lastRefill = now;
+    credit = rate;
+  }
+  /* never bank more than one second of budget */
+  credit = std::min(rate, credit + (now - lastRefill) * rate);
+  lastRefill = now;
+}
+
+double regionSched::benefit(const basicBlock *head) {
+  std::unordered_set<const basicBlock*> blks;
+  std::unordered_set<uint32_t> entries;
+  for(const auto &r : head->bbRegions) {
+    for(const basicBlock *bb : r) {
+      blks.insert(bb);
+      entries.insert(bb->getEntryAddr());
+    }
+  }
+  double dynInsns = 0.0, staticInsns = 0.0;
+  uint64_t inEdges = 0, allEdges = 0;
+  for(const basicBlock *bb : blks) {
+    dynInsns += bb->getInscnt();
+    staticInsns += bb->getNumIns();
+    for(const auto &e : bb->edgeCnts) {
+      allEdges += e.second;
+      if(entries.find(e.first) != entries.end()) {
+	inEdges += e.second;
+      }
+    }
+  }
+  /* the past profile stands in for the future one, insns
+   * behind edges that leave the region pay a region exit
+   * and don't count */
+  double stay = allEdges ? static_cast<double>(inEdges) / allEdges : 0.0;
+  return (dynInsns * stay * interpSecsSavedPerInsn) -
+    (staticInsns * compileSecsPerInsn());
+}
+
+bool regionSched::stale(const std::pair<double, basicBlock*> &e) {
+  auto it = pending.find(e.second);
+  return it == pending.end() or it->second.benefit != e.first;
+}
+
+void regionSched::submit(basicBlock *head) {
+  if(globals::compileBudget <= 0.0) {
+    head->compileRegions();
+    return;
+  }
+  pending_t &p = pending[head];
+  p.benefit = benefit(head);
+  if(p.benefit <= 0.0 and ++p.waits > maxWaits) {
+    /* the profile never made it pay, collect a new one */
+    pending.erase(head);
+    head->bbRegions.clear();
+    head->bbRegionCounts.clear();
+    head->hasRegion = false;
+    dropped++;
+    return;
+  }
+  heap.emplace_back(p.benefit, head);
+  std::push_heap(heap.begin(), heap.end());
+  /* stale entries pile up behind unprofitable heads */
+  if(heap.size() > (4*pending.size() + 64)) {
+    heap.erase(std::remove_if(heap.begin(), heap.end(), stale), heap.end());
+    std::make_heap(heap.begin(), heap.end());
+  }
+  drain();
+  auto it = pending.find(head);
+  if(it != pending.end() and not(it->second.counted)) {
+    it->second.counted = true;
+    deferred++;
+  }
+}
+
+void regionSched::remove(basicBlock *head) {
+  pending.erase(head);
+}
+
+void regionSched::drain() {
+  refill();
+  while(credit > 0.0 and not(heap.empty())) {
+    if(stale(heap.front())) {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.pop_back();
+      continue;
+    }
+    if(heap.front().first <= 0.0) {
+      break;
+    }
+    basicBlock *best = heap.front().second;
+    std::pop_heap(heap.begin(), heap.end());
+    heap.pop_back();
+    pending.erase(best);
+    /* regions may have been scrubbed by code invalidation */
+    if(best->bbRegions.empty()) {
+      continue;
+    }
+    std::unordered_set<const basicBlock*> blks;
+    uint64_t nInsns = 0;
+    for(const auto &r : best->bbRegions) {
+      for(const basicBlock *bb : r) {
+	if(blks.insert(bb).second) {
+	  nInsns += bb->getNumIns();
+	}
+      }
+    }
+    double t0 = timestamp();
+    best->compileRegions();
+    double dt = timestamp() - t0;
+    compileSecs += dt;
+    compiledInsns += nInsns;
+    credit -= dt;
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef __REGIONSCHED_HH__
+#define __REGIONSCHED_HH__
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class basicBlock;
+
+/* region compile scheduler : heads with enough regions queue here
+ * instead of compiling on the spot. compile time is metered by a
+ * token bucket that refills at globals::compileBudget ms per wall
+ * clock second (0 compiles everything as soon as it is ready).
+ * while there is budget the pending head with the largest
+ * projected saving is compiled first. a head's saving is projected
+ * when it is submitted and kept in a max heap, heads projected to
+ * save less than they cost to compile wait for more profile and
+ * start over after maxWaits submissions that didn't pay */
+class regionSched {
+private:
+  struct pending_t {
+    double benefit = 0.0;
+    uint32_t waits = 0;
+    bool counted = false;
+  };
+  static const uint32_t maxWaits = 8;
+  static std::unordered_map<basicBlock*, pending_t> pending;
+  /* (benefit, head), an entry is stale once its head was
+   * submitted again or removed */
+  static std::vector<std::pair<double, basicBlock*>> heap;
+  static double credit;
+  static double lastRefill;
+  static double compileSecs;
+  static uint64_t compiledInsns;
+  static uint32_t pollCnt;
+  static void refill();
+  static double compileSecsPerInsn();
+  static bool stale(const std::pair<double, basicBlock*> &e);
+public:
+  static uint64_t deferred;
+  static uint64_t dropped;
+  static double benefit(const basicBlock *head);
+  static void submit(basicBlock *head);
+  static void remove(basicBlock *head);
+  static void drain();
+  static void poll() {
+    /* only look at the clock every so often */
+    if(not(pending.empty()) and ((++pollCnt & 255) == 0)) {
+      drain();
+    }
+  }
+  static size_t numPending() {
+    return pending.size();
+  }
+};
+
+#endif
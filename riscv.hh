@@ -147,6 +147,10 @@ static inline bool isDirectBranchOrJump(uint32_t inst, uint32_t addr, uint32_t &
   return false;
 }
 
+static inline bool is_fencei(uint32_t inst) {
+  return ((inst & 127) == 0xf) and (((inst >> 12) & 7) == 1);
+}
+
 static inline bool is_monitor(uint32_t inst) {
   uint32_t opcode = inst & 127;
   if(opcode != 0x73)
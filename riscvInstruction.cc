@@ -5,6 +5,7 @@
 #include "regionCFG.hh"
 #include "helper.hh"
 #include "globals.hh"
+#include "hle.hh"
 
 typedef llvm::Value lv_t;
 
@@ -203,7 +204,7 @@ void Insn::saveInstAddress() {
   llvm::Value *vZ = llvm::ConstantInt::get(iType64,0);
   llvm::Value *vAddr = llvm::ConstantInt::get(iType64,(uint64_t)addr);
   llvm::Value *vG = cfg->myIRBuilder->MakeGEP(cfg->blockArgMap["icnt"], vZ);
-  cfg->myIRBuilder->CreateStore(vAddr, vG);
+  cfg->setTBAA(cfg->myIRBuilder->CreateStore(vAddr, vG), cfg->tbaaIcnt);
 }
 
 void Insn::codeGen(cfgBasicBlock *cBB, llvmRegTables& regTbl) {
@@ -246,7 +247,9 @@ bool iBranchTypeInsn::handleBranch(cfgBasicBlock *cBB,
     llvm::BasicBlock *t1 = ntBB = cfg->generateAbortBasicBlock(ntAddr,regTbl,cBB,ntBB,addr);
     tBB = t0;
     ntBB = t1;
-    cfg->myIRBuilder->CreateCondBr(vCMP, tBB, ntBB);
+    cfg->myIRBuilder->CreateCondBr(vCMP, tBB, ntBB,
+				   cfg->branchWeights(cBB->succCount(tAddr),
+						      cBB->succCount(ntAddr)));
   }
   else {
     tBB = cfg->generateAbortBasicBlock(tAddr, regTbl,cBB,tBB,addr);
@@ -279,6 +282,20 @@ void insn_jal::recDefines(cfgBasicBlock *cBB, regionCFG *cfg)  {
   uint32_t rd = (inst>>7) & 31;
   assert(rd != 0);
   cfg->gprDefinitionBlocks[rd].insert(cBB);
+  if(hleFn() >= 0) {
+    cfg->gprDefinitionBlocks[10].insert(cBB);
+  }
+}
+
+int32_t insn_jal::hleFn() const {
+  uint32_t rd = (inst>>7) & 31;
+  return (rd == 1) ? hleLookup(getJumpAddr()) : -1;
+}
+
+void insn_jal::recUses(cfgBasicBlock *cBB) {
+  if(hleFn() >= 0) {
+    cBB->gprRead[10] = cBB->gprRead[11] = cBB->gprRead[12] = true;
+  }
 }
 
 
@@ -613,17 +630,9 @@ bool rTypeInsn::generateIR(cfgBasicBlock *cBB, llvmRegTables& regTbl) {
 bool insn_sb::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
   int32_t disp = r.s.imm4_0 | (r.s.imm11_5 << 5);
   disp |= ((inst>>31)&1) ? 0xfffff000 : 0x0;
-  
-  llvm::Value *vIMM = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(cfg->Context)),disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.s.rs1];
   llvm::Value *vRT = regTbl.gprTbl[r.s.rs2];
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA = cfg->myIRBuilder->CreateZExt(vEA, llvm::Type::getInt64Ty(*(cfg->Context)));
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
-  llvm::Value *vPtr = cfg->myIRBuilder->CreateBitCast(vGEP,llvm::Type::getInt8PtrTy(*(cfg->Context)));
   llvm::Value *vTrunc = cfg->myIRBuilder->CreateTrunc(vRT, llvm::Type::getInt8Ty(*(cfg->Context)));
-  cfg->myIRBuilder->CreateStore(vTrunc, vPtr);
+  regTbl.storeMem(r.s.rs1, disp, vTrunc);
   return false;
 }
 
@@ -631,34 +640,18 @@ bool insn_sh::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
   llvm::LLVMContext &cxt = *(cfg->Context);
   int32_t disp = r.s.imm4_0 | (r.s.imm11_5 << 5);
   disp |= ((inst>>31)&1) ? 0xfffff000 : 0x0;
-  llvm::Value *vIMM = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(cfg->Context)),disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.s.rs1];
   llvm::Value *vRT = regTbl.gprTbl[r.s.rs2];
-
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA = cfg->myIRBuilder->CreateZExt(vEA, llvm::Type::getInt64Ty(cxt));
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
-  llvm::Value *vPtr = cfg->myIRBuilder->CreateBitCast(vGEP, llvm::Type::getInt16PtrTy(cxt));
   llvm::Value *vTrunc = cfg->myIRBuilder->CreateTrunc(vRT, llvm::Type::getInt16Ty(cxt));
-  cfg->myIRBuilder->CreateStore(vTrunc, vPtr);
+  regTbl.storeMem(r.s.rs1, disp, vTrunc);
   return false;
 }
 
 
 
 bool insn_sw::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
-  llvm::LLVMContext &cxt = *(cfg->Context);
   int32_t disp = r.s.imm4_0 | (r.s.imm11_5 << 5);
   disp |= ((inst>>31)&1) ? 0xfffff000 : 0x0;
-  llvm::Value *vIMM = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(cfg->Context)),disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.s.rs1];
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA = cfg->myIRBuilder->CreateZExt(vEA, llvm::Type::getInt64Ty(cxt));
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
-  llvm::Value *vPtr = cfg->myIRBuilder->CreateBitCast(vGEP, llvm::Type::getInt32PtrTy(cxt));
-  cfg->myIRBuilder->CreateStore(regTbl.gprTbl[r.s.rs2], vPtr);
+  regTbl.storeMem(r.s.rs1, disp, regTbl.gprTbl[r.s.rs2]);
   return false;
 }
 
@@ -668,14 +661,8 @@ bool insn_lbu::generateIR(cfgBasicBlock *cBB, llvmRegTables& regTbl) {
   if((inst>>31)&1) {
     disp |= 0xfffff000;
   }
-  llvm::Value *vIMM = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(cfg->Context)),disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.l.rs1];
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA =  cfg->myIRBuilder->CreateZExt(vEA, llvm::Type::getInt64Ty(*(cfg->Context)));
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
   std::string loadName = "lbu_" + std::to_string(cfg->getuuid()++) + "_" + toStringHex(addr);
-  llvm::Value *vLoad = cfg->myIRBuilder->MakeLoad(vGEP,loadName);
+  llvm::Value *vLoad = regTbl.loadMem(r.l.rs1, disp, llvm::Type::getInt8Ty(*(cfg->Context)), loadName);
   llvm::Value *vSext = cfg->myIRBuilder->CreateZExt(vLoad, llvm::Type::getInt32Ty(*(cfg->Context)));
   regTbl.gprTbl[r.l.rd] = vSext;
   return false;
@@ -688,15 +675,8 @@ bool insn_lb::generateIR(cfgBasicBlock *cBB, llvmRegTables& regTbl) {
   }  
   llvm::LLVMContext &cxt = *(cfg->Context);
   llvm::Type *iType32 = llvm::Type::getInt32Ty(cxt);
-  llvm::Type *iType64 = llvm::Type::getInt64Ty(cxt);
-  llvm::Value *vIMM = llvm::ConstantInt::get(iType32,disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.l.rs1];
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA = cfg->myIRBuilder->CreateZExt(vEA, iType64);
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
   std::string loadName = "lb_" + std::to_string(cfg->getuuid()++) + "_" + toStringHex(addr);
-  llvm::Value *vLoad = cfg->myIRBuilder->MakeLoad(vGEP,loadName);
+  llvm::Value *vLoad = regTbl.loadMem(r.l.rs1, disp, llvm::Type::getInt8Ty(cxt), loadName);
   regTbl.gprTbl[r.l.rd] = cfg->myIRBuilder->CreateSExt(vLoad,iType32);
   return false;
 }
@@ -706,15 +686,8 @@ bool insn_lh::generateIR(cfgBasicBlock *cBB, llvmRegTables& regTbl) {
   if((inst>>31)&1) {
     disp |= 0xfffff000;
   }    
-  llvm::Value *vIMM = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(cfg->Context)),disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.l.rs1];
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA =  cfg->myIRBuilder->CreateZExt(vEA, llvm::Type::getInt64Ty(*(cfg->Context)));
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
-  llvm::Value *vPtr = cfg->myIRBuilder->CreateBitCast(vGEP, llvm::Type::getInt16PtrTy(*(cfg->Context)));
   std::string loadName = "lh_" + std::to_string(cfg->getuuid()++) + "_" + toStringHex(addr);
-  llvm::Value *vLoad = cfg->myIRBuilder->MakeLoad(vPtr,loadName);
+  llvm::Value *vLoad = regTbl.loadMem(r.l.rs1, disp, llvm::Type::getInt16Ty(*(cfg->Context)), loadName);
   llvm::Value *vSext = cfg->myIRBuilder->CreateSExt(vLoad,  
 						    llvm::Type::getInt32Ty(*(cfg->Context)));
   regTbl.gprTbl[r.l.rd] = vSext;
@@ -728,16 +701,8 @@ bool insn_lhu::generateIR(cfgBasicBlock *cBB, llvmRegTables& regTbl) {
     disp |= 0xfffff000;
   }      
   llvm::Type *iType32 = llvm::Type::getInt32Ty(cxt);
-  llvm::Type *iType64 = llvm::Type::getInt64Ty(cxt);
-  llvm::Value *vIMM = llvm::ConstantInt::get(iType32, disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.l.rs1];
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA =  cfg->myIRBuilder->CreateZExt(vEA, iType64);
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
-  llvm::Value *vPtr = cfg->myIRBuilder->CreateBitCast(vGEP, llvm::Type::getInt16PtrTy(cxt));
   std::string loadName = "lhu_" + std::to_string(cfg->getuuid()++) + "_" + toStringHex(addr);
-  llvm::Value *vLoad = cfg->myIRBuilder->MakeLoad(vPtr,loadName);
+  llvm::Value *vLoad = regTbl.loadMem(r.l.rs1, disp, llvm::Type::getInt16Ty(cxt), loadName);
   regTbl.gprTbl[r.l.rd] = cfg->myIRBuilder->CreateZExt(vLoad, iType32);
   return false;
 }
@@ -747,15 +712,8 @@ bool insn_lw::generateIR(cfgBasicBlock *cBB, llvmRegTables& regTbl) {
   if((inst>>31)&1) {
     disp |= 0xfffff000;
   }    
-  llvm::Value *vIMM = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(cfg->Context)),disp);
-  llvm::Value *vRS = regTbl.gprTbl[r.l.rs1];
-  llvm::Value *vEA = cfg->myIRBuilder->CreateAdd(vRS, vIMM);
-  llvm::Value *vZEA =  cfg->myIRBuilder->CreateZExt(vEA, llvm::Type::getInt64Ty(*(cfg->Context)));
-  llvm::Value *vMem = cfg->blockArgMap["mem"];
-  llvm::Value *vGEP = cfg->myIRBuilder->MakeGEP(vMem, vZEA);
-  llvm::Value *vPtr = cfg->myIRBuilder->CreateBitCast(vGEP, llvm::Type::getInt32PtrTy(*(cfg->Context)));
   std::string loadName = "lw_" + std::to_string(cfg->getuuid()++) + "_" + toStringHex(addr);
-  regTbl.gprTbl[r.l.rd] = cfg->myIRBuilder->MakeLoad(vPtr,loadName); 
+  regTbl.gprTbl[r.l.rd] = regTbl.loadMem(r.l.rs1, disp, llvm::Type::getInt32Ty(*(cfg->Context)), loadName);
   return false;
 }
 
@@ -800,15 +758,10 @@ bool insn_j::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
     (r.j.imm20 << 20);
   jaddr |= ((inst>>31)&1) ? 0xffe00000 : 0x0;
   jaddr += addr;
+  /* grown and translated regions can end at a jump whose
+   * target was left out, leave the region there */
   llvm::BasicBlock *tBB = cBB->getSuccLLVMBasicBlock(jaddr);
-
-  if(tBB==nullptr) {
-    std::cerr << "COULDNT FIND 0x" << std::hex << jaddr
-	      << " from 0x" << addr
-	      << std::dec << "\n";
-    std::cerr << *cfg;
-    die();
-  }
+  tBB = cfg->generateAbortBasicBlock(jaddr, regTbl, cBB, tBB, addr);
   cfg->myIRBuilder->CreateBr(tBB);
   cBB->hasTermBranchOrJump = true;
   return true;
@@ -819,8 +772,22 @@ bool insn_jal::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
   uint32_t rd = (inst>>7) & 31;
   assert(rd != 0);
   regTbl.gprTbl[rd] = llvm::ConstantInt::get(llvm::Type::getInt32Ty(cxt),(addr+4));
-  cfgBasicBlock *nBB = *(cBB->succs.begin());
-  cfg->myIRBuilder->CreateBr(nBB->lBB);
+  int32_t fn = hleFn();
+  if(fn >= 0) {
+    /* the interpreter continued at ra, so does the region. a
+     * call the host turns down leaves for the guest routine */
+    llvm::BasicBlock *gBB = cfg->generateAbortBasicBlock(getJumpAddr(), regTbl, cBB, nullptr, addr);
+    llvm::Value *vDone = cfg->emitHLECall(fn, regTbl);
+    llvm::BasicBlock *tBB = cBB->getSuccLLVMBasicBlock(addr + 4);
+    tBB = cfg->generateAbortBasicBlock(addr + 4, regTbl, cBB, tBB, addr);
+    cfg->myIRBuilder->CreateCondBr(vDone, tBB, gBB, cfg->branchWeights(1, 0));
+  }
+  else {
+    uint32_t target = getJumpAddr();
+    llvm::BasicBlock *tBB = cBB->getSuccLLVMBasicBlock(target);
+    tBB = cfg->generateAbortBasicBlock(target, regTbl, cBB, tBB, addr);
+    cfg->myIRBuilder->CreateBr(tBB);
+  }
   cBB->hasTermBranchOrJump = true;
   return true;
 }
@@ -847,21 +814,27 @@ bool insn_jr::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
   vNPC = cfg->myIRBuilder->CreateAdd(vNPC, llvm::ConstantInt::get(iType32,tgt));
   vNPC = cfg->myIRBuilder->CreateAnd(vNPC, llvm::ConstantInt::get(iType32,(~1U)));
   
-  for(cfgBasicBlock* next : cBB->succs) {
-      uint32_t nAddr = next->getEntryAddr();
-      llvm::Value *vAddr = llvm::ConstantInt::get(iType32,nAddr);
-      llvm::Value *vCmp = cfg->myIRBuilder->CreateICmpEQ(vNPC, vAddr);
-      cmpz.push_back(vCmp);
-    }
+  /* test the most frequent targets first */
+  const std::vector<cfgBasicBlock*> targets = cBB->succsByFreq();
+  for(cfgBasicBlock *next : targets) {
+    uint32_t nAddr = next->getEntryAddr();
+    llvm::Value *vAddr = llvm::ConstantInt::get(iType32,nAddr);
+    llvm::Value *vCmp = cfg->myIRBuilder->CreateICmpEQ(vNPC, vAddr);
+    cmpz.push_back(vCmp);
+  }
 
   size_t p = 0;
   fallT[p++] = llvm::BasicBlock::Create(cxt,"ft",cfg->blockFunction);
   cfg->myIRBuilder->CreateBr(fallT[0]);
   cfg->myIRBuilder->SetInsertPoint(fallT[0]);
-  for(cfgBasicBlock* next : cBB->succs) {
+  uint64_t remaining = cBB->bb->getTotalEdges();
+  for(cfgBasicBlock* next : targets) {
       size_t pp = p-1;
+      uint64_t c = std::min(remaining, cBB->succCount(next->getEntryAddr()));
+      remaining -= c;
       fallT[p++] = llvm::BasicBlock::Create(cxt,"ft",cfg->blockFunction);
-      cfg->myIRBuilder->CreateCondBr(cmpz[pp], next->lBB, fallT[p-1]);
+      cfg->myIRBuilder->CreateCondBr(cmpz[pp], next->lBB, fallT[p-1],
+				     cfg->branchWeights(c, remaining));
       cBB->jrMap[next->lBB] = fallT[pp];
       cfg->myIRBuilder->SetInsertPoint(fallT[p-1]);
     }
@@ -885,7 +858,9 @@ bool insn_jalr::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
 
   llvm::Value *vNPC = regTbl.gprTbl[r.jj.rs1];
 
-  for(cfgBasicBlock *next : cBB->succs) {
+  /* test the most frequent targets first */
+  const std::vector<cfgBasicBlock*> targets = cBB->succsByFreq();
+  for(cfgBasicBlock *next : targets) {
     uint32_t nAddr = next->getEntryAddr();
     llvm::Value *vAddr = llvm::ConstantInt::get(iType32,nAddr);
     llvm::Value *vCmp = cfg->myIRBuilder->CreateICmpEQ(vNPC, vAddr);
@@ -897,10 +872,14 @@ bool insn_jalr::generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) {
   fallT[p++] = llvm::BasicBlock::Create(cxt,"ft",cfg->blockFunction);
   cfg->myIRBuilder->CreateBr(fallT[0]);
   cfg->myIRBuilder->SetInsertPoint(fallT[0]);
-  for(cfgBasicBlock* next : cBB->succs) {
+  uint64_t remaining = cBB->bb->getTotalEdges();
+  for(cfgBasicBlock* next : targets) {
       size_t pp = p-1;
+      uint64_t c = std::min(remaining, cBB->succCount(next->getEntryAddr()));
+      remaining -= c;
       fallT[p++] = llvm::BasicBlock::Create(cxt,"ft",cfg->blockFunction);
-      cfg->myIRBuilder->CreateCondBr(cmpz[pp], next->lBB, fallT[p-1]);
+      cfg->myIRBuilder->CreateCondBr(cmpz[pp], next->lBB, fallT[p-1],
+				     cfg->branchWeights(c, remaining));
       cBB->jrMap[next->lBB] = fallT[pp];
       cfg->myIRBuilder->SetInsertPoint(fallT[p-1]);
     }
@@ -142,9 +142,11 @@ public:
     jaddr += addr;
     return jaddr;
   }  
+  /* emulated libc routine called by this jal, or -1 */
+  int32_t hleFn() const;
   bool generateIR(cfgBasicBlock *cBB,  llvmRegTables& regTbl) override;
   void recDefines(cfgBasicBlock *cBB, regionCFG *cfg) override;
-  void recUses(cfgBasicBlock *cBB) override {}
+  void recUses(cfgBasicBlock *cBB) override;
 };
 
 
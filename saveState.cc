@@ -6,6 +6,7 @@
 #include <fcntl.h>
 #include "interpret.hh"
 #include "state.hh"
+#include "memProtect.hh"
 
 struct page {
   uint32_t va;
@@ -30,6 +31,9 @@ void dumpState(const state_t &s, const std::string &filename) {
   
   /* mark non-zero pages */
   for(int p = 0; p < n_pages; p++) {
+    if(isGuardPage(p*4096)) {
+      continue;
+    }
     for(int pp = 0; pp < 512; pp++) {
       if(mem64[p*512+pp]) {
 	nz_pages[p] = true;
@@ -4,6 +4,7 @@
 #include <array>
 #include <set>
 #include <vector>
+#include "regionArena.hh"
 
 template <typename T>
 class MipsRegTable {
@@ -37,6 +38,12 @@ public:
   ssaInsn(insnDefType insnType = insnDefType::unknown) :
     insnType(insnType) {}
   virtual ~ssaInsn() {}
+  static void *operator new(size_t sz) {
+    return regionArena::allocate(sz);
+  }
+  static void operator delete(void *p) {
+    regionArena::release(p);
+  }
   void addUse(ssaInsn *u) {
     uses.insert(u);
   }
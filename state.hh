@@ -18,6 +18,7 @@ struct state_t{
   uint8_t brk;
   uint8_t bad_addr;
   uint32_t epc;
+  uint32_t bad_vaddr;
   uint64_t maxicnt;
   uint64_t icnt;
 };
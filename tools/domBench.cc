@@ -0,0 +1,310 @@
+/* dominator benchmark : times the iterative bitset dominators
+ * analyzeGraph used below 512 blocks against the Lengauer-Tarjan
+ * pass and dominance frontiers in dominators.hh, and checks that
+ * every idom agrees.
+ *
+ * tools/domBench [-s seed] [-p profile] [blocks...]
+ *
+ * without -p it runs synthetic graphs of each size (64 256 1024
+ * 4096 by default) : a chain with a back or forward edge on every
+ * third block. with -p it runs every region of a --saveRegions
+ * profile, edges are the recorded ones between the region's
+ * blocks */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/dynamic_bitset.hpp>
+
+#include "dominators.hh"
+
+struct node {
+  std::vector<node*> succs, preds;
+  std::vector<node*> dtree_succs;
+  std::vector<node*> dfrontier;
+  node *idombb = nullptr;
+  int32_t cfgId = 0;
+  const std::vector<node*> &getSuccs() const {
+    return succs;
+  }
+  const std::vector<node*> &getPreds() const {
+    return preds;
+  }
+  node* &getIdom() {
+    return idombb;
+  }
+  void addDTreeSucc(node *bb) {
+    dtree_succs.push_back(bb);
+  }
+  void addSuccessor(node *bb) {
+    for(node *s : succs) {
+      if(s == bb) {
+	return;
+      }
+    }
+    succs.push_back(bb);
+    bb->preds.push_back(this);
+  }
+};
+
+/* blocks[0] is the entry, every block is reachable from it */
+struct graph {
+  std::string name;
+  std::vector<node> nodes;
+  std::vector<node*> blocks;
+  explicit graph(size_t n) : nodes(n) {
+    for(node &nd : nodes) {
+      blocks.push_back(&nd);
+    }
+  }
+  void reset() {
+    for(node &nd : nodes) {
+      nd.dtree_succs.clear();
+      nd.dfrontier.clear();
+      nd.idombb = nullptr;
+    }
+  }
+};
+
+/* regionCFG::computeDominance as it was before the switch to
+ * Lengauer-Tarjan for every region size */
+static void iterativeDominance(const std::vector<node*> &cfgBlocks, node *entryBlock) {
+  using namespace boost;
+  using namespace std;
+  bool changed = true;
+  vector<node*> preOrderVisit(cfgBlocks.size());
+  std::map<node*, size_t> blockToNumMap;
+
+  map<node*, dynamic_bitset<>> domMap;
+
+  size_t dfsNum = 0;
+
+  /* use DFS to compute DFS numbers */
+  function<void(node*)> dfs =[&](node* bb) {
+    preOrderVisit.at(dfsNum) = bb;
+    blockToNumMap[bb] = dfsNum;
+    dfsNum++;
+    domMap[bb] = dynamic_bitset<>(cfgBlocks.size());
+    domMap.at(bb).set();
+    for(auto nbb : bb->succs) {
+      auto it = blockToNumMap.find(nbb);
+      if(it == blockToNumMap.end()) {
+	dfs(nbb);
+      }
+    }
+  };
+
+  /* initialize */
+  dfs(entryBlock);
+
+  domMap.at(entryBlock).reset();
+  domMap.at(entryBlock)[0] = true;
+
+  /* compute dominators */
+  do {
+    changed = false;
+    for(size_t bId=0, n=preOrderVisit.size(); bId < n; bId++) {
+      node *cbb = preOrderVisit[bId];
+      dynamic_bitset<> tdd = domMap.at(cbb);
+      for(node *nbb : cbb->getPreds()) {
+	tdd &= domMap.at(nbb);
+      }
+      tdd[bId] = true;
+      //check if changed
+      if(tdd != domMap.at(cbb)) {
+	changed = true;
+	domMap.at(cbb) = tdd;
+      }
+    }
+  }
+  while(changed);
+
+  for(size_t i = 1, n = preOrderVisit.size(); i < n; i++) {
+    node *cbb = preOrderVisit[i];
+    dynamic_bitset<> &dom = domMap.at(cbb);
+    dom[i] = false;
+    /* iterate over blocks that dominate current block */
+    for(size_t j = dom.find_first(); j != dynamic_bitset<>::npos; j = dom.find_next(j)) {
+      const dynamic_bitset<> &ddom = domMap.at(preOrderVisit.at(j));
+      for(size_t k = ddom.find_first(); k != dynamic_bitset<>::npos; k = ddom.find_next(k)) {
+	/* if j dominates k, k can not be the immediate dominator */
+	if(k!=j)
+	  dom[k]=false;
+      }
+    }
+    cbb->getIdom() = preOrderVisit.at(dom.find_first());
+    cbb->getIdom()->addDTreeSucc(cbb);
+  }
+  entryBlock->getIdom() = nullptr;
+}
+
+static graph *synthetic(size_t n, std::mt19937 &rng) {
+  graph *g = new graph(n + 1);
+  g->name = "synthetic " + std::to_string(n);
+  std::uniform_int_distribution<size_t> pick(1, n);
+  for(size_t i = 0; i < n; i++) {
+    g->blocks[i]->addSuccessor(g->blocks[i+1]);
+    if(i and (i % 3) == 0) {
+      g->blocks[i]->addSuccessor(g->blocks[pick(rng)]);
+    }
+  }
+  return g;
+}
+
+/* the bb and region records of a region profile, see
+ * regionProfile::save. crcs and counts are skipped */
+static bool recorded(const std::string &fname, std::vector<graph*> &graphs) {
+  std::ifstream in(fname);
+  std::string tag;
+  uint32_t v = 0;
+  in >> tag >> v >> std::hex;
+  if(tag != "rv32-regions") {
+    return false;
+  }
+  std::map<uint32_t, std::vector<uint32_t>> edges;
+  while(in >> tag) {
+    if(tag == "bb") {
+      uint32_t entry = 0, term = 0, crc = 0, pc = 0;
+      uint64_t inscnt = 0, totalEdges = 0, nEdges = 0, cnt = 0;
+      in >> entry >> term >> crc >> inscnt >> totalEdges >> nEdges;
+      std::vector<uint32_t> &e = edges[entry];
+      for(uint64_t i = 0; in and i < nEdges; i++) {
+	in >> pc >> cnt;
+	e.push_back(pc);
+      }
+    }
+    else if(tag == "region") {
+      uint32_t head = 0, pc = 0;
+      uint64_t n = 0;
+      in >> head >> n;
+      std::set<uint32_t> pcs = {head};
+      for(uint64_t i = 0; in and i < n; i++) {
+	in >> pc;
+	pcs.insert(pc);
+      }
+      /* only what the head reaches, like buildCFG insists on */
+      std::vector<uint32_t> order = {head};
+      std::map<uint32_t, size_t> ids = {{head, 1}};
+      for(size_t i = 0; i < order.size(); i++) {
+	for(uint32_t t : edges[order[i]]) {
+	  if(pcs.count(t) and ids.emplace(t, order.size() + 1).second) {
+	    order.push_back(t);
+	  }
+	}
+      }
+      graph *g = new graph(order.size() + 1);
+      char buf[64];
+      snprintf(buf, sizeof(buf), "region %x", head);
+      g->name = buf;
+      g->blocks[0]->addSuccessor(g->blocks[1]);
+      for(size_t i = 0; i < order.size(); i++) {
+	for(uint32_t t : edges[order[i]]) {
+	  auto it = ids.find(t);
+	  if(it != ids.end()) {
+	    g->blocks[i+1]->addSuccessor(g->blocks[it->second]);
+	  }
+	}
+      }
+      graphs.push_back(g);
+    }
+    else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* microseconds per call, repeated for at least 20 ms */
+static double timeIt(graph *g, const std::function<void()> &f) {
+  using clk = std::chrono::steady_clock;
+  size_t reps = 0;
+  auto t0 = clk::now();
+  double el = 0.0;
+  do {
+    g->reset();
+    f();
+    reps++;
+    el = std::chrono::duration<double, std::micro>(clk::now() - t0).count();
+  } while(el < 20e3);
+  return el / reps;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t seed = 1;
+  std::string profile;
+  std::vector<size_t> sizes;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if(a == "-s" and (i + 1) < argc) {
+      seed = std::strtoul(argv[++i], nullptr, 0);
+    }
+    else if(a == "-p" and (i + 1) < argc) {
+      profile = argv[++i];
+    }
+    else {
+      sizes.push_back(std::strtoul(argv[i], nullptr, 0));
+    }
+  }
+  std::vector<graph*> graphs;
+  if(not(profile.empty())) {
+    if(not(recorded(profile, graphs))) {
+      std::cerr << "can't read region profile " << profile << "\n";
+      return -1;
+    }
+  }
+  else {
+    if(sizes.empty()) {
+      sizes = {64, 256, 1024, 4096};
+    }
+    std::mt19937 rng(seed);
+    for(size_t n : sizes) {
+      graphs.push_back(synthetic(n, rng));
+    }
+  }
+
+  printf("%-16s %8s %14s %14s %16s\n", "graph", "blocks",
+	 "iterative us", "lengauer us", "lt+frontier us");
+  double tot[3] = {0.0, 0.0, 0.0};
+  int rc = 0;
+  for(graph *g : graphs) {
+    node *root = g->blocks[0];
+    double ti = timeIt(g, [&]() {iterativeDominance(g->blocks, root);});
+    std::vector<node*> idoms;
+    for(node *nd : g->blocks) {
+      idoms.push_back(nd->getIdom());
+    }
+    double tl = timeIt(g, [&]() {
+	LengauerTarjanDominators<node> LTD(g->blocks, root);
+	LTD();
+      });
+    for(size_t i = 0; i < g->blocks.size(); i++) {
+      if(g->blocks[i]->getIdom() != idoms[i]) {
+	std::cerr << g->name << " : idom mismatch at block " << i << "\n";
+	rc = -1;
+	break;
+      }
+    }
+    double tf = timeIt(g, [&]() {
+	LengauerTarjanDominators<node> LTD(g->blocks, root);
+	LTD();
+	computeDominanceFrontiers(g->blocks);
+      });
+    printf("%-16s %8zu %14.2f %14.2f %16.2f\n", g->name.c_str(),
+	   g->blocks.size() - 1, ti, tl, tf);
+    tot[0] += ti;
+    tot[1] += tl;
+    tot[2] += tf;
+    delete g;
+  }
+  if(graphs.size() > 1) {
+    printf("%-16s %8s %14.2f %14.2f %16.2f\n", "total", "", tot[0], tot[1], tot[2]);
+  }
+  return rc;
+}